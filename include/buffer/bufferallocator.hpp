@@ -0,0 +1,391 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+//DataBuffer的内存分配接口,语义和malloc/realloc/free相同
+class BufferAllocator
+{
+public:
+	virtual ~BufferAllocator() {}
+
+	virtual void* Allocate(size_t size) = 0;
+	//ptr为nullptr时等同Allocate,失败时返回nullptr且ptr保持不变
+	virtual void* Reallocate(void* ptr, size_t size) = 0;
+	virtual void Deallocate(void* ptr) = 0;
+};
+
+//直接使用malloc/realloc/free
+class MallocAllocator : public BufferAllocator
+{
+public:
+	static MallocAllocator& Instance()
+	{
+		static MallocAllocator instance;
+		return instance;
+	}
+
+	void* Allocate(size_t size) override { return malloc(size); }
+	void* Reallocate(void* ptr, size_t size) override { return realloc(ptr, size); }
+	void Deallocate(void* ptr) override { free(ptr); }
+};
+
+//按2的幂分级的线程缓存池
+//  64B~256KB按级别缓存在当前线程的空闲链表里,分配和本线程释放都不加锁
+//  别的线程释放的块用CAS挂到所属线程的remote_链表上,所属线程分配未命中或挂起的字节数超过kRemoteDrainBytes时一次取回
+//  超过256KB的直接走malloc
+//  线程退出后它的缓存留给之后新建的线程复用,不释放,其它线程归还的块仍然可以挂上去
+class PoolAllocator : public BufferAllocator
+{
+public:
+	static const uint32_t kMinClassShift = 6;
+	static const uint32_t kMaxClassShift = 18;
+	static const uint32_t kClassCount = kMaxClassShift - kMinClassShift + 1;
+	static const uint32_t kLargeClass = kClassCount;
+
+	//每个线程每个级别最多缓存的字节数,至少缓存kMinCachedBlocks块
+	static const size_t kMaxCachedBytesPerClass = 1024 * 1024;
+	static const uint32_t kMinCachedBlocks = 4;
+
+	//其它线程归还、还没取回的字节数超过这个值时,下次分配就取回,即使当前级别命中
+	static const size_t kRemoteDrainBytes = 256 * 1024;
+
+	struct Stats
+	{
+		uint64_t allocations_;		//池内级别的分配次数(不含大块)
+		uint64_t cache_hits_;		//其中从线程缓存直接取到的次数
+		uint64_t remote_frees_;		//由其它线程释放的次数
+		uint64_t remote_pending_bytes_;	//其它线程已归还、所属线程还没取回的字节数
+		uint64_t large_allocations_;	//超过最大级别、直接走malloc的次数
+		uint64_t cached_bytes_;		//所有线程缓存中空闲块的字节数
+		uint64_t thread_caches_;		//创建过的线程缓存数
+	};
+
+	static PoolAllocator& Instance()
+	{
+		static PoolAllocator instance;
+		return instance;
+	}
+
+	void* Allocate(size_t size) override
+	{
+		uint32_t size_class = GetSizeClass(size);
+		if (size_class == kLargeClass)
+			return AllocateLarge(size);
+
+		ThreadCache& cache = GetLocalCache();
+		Increase(cache.allocations_);
+
+		FreeBlock* block = cache.free_[size_class];
+		if ((block == nullptr && cache.remote_.load(std::memory_order_relaxed) != nullptr)
+			|| cache.remote_bytes_.load(std::memory_order_relaxed) >= kRemoteDrainBytes)
+		{
+			DrainRemote(cache);
+			block = cache.free_[size_class];
+		}
+
+		if (block != nullptr)
+		{
+			cache.free_[size_class] = block->next_;
+			--cache.free_count_[size_class];
+			cache.cached_bytes_.store(cache.cached_bytes_.load(std::memory_order_relaxed) - GetClassSize(size_class), std::memory_order_relaxed);
+			Increase(cache.cache_hits_);
+			return block;
+		}
+
+		BlockHeader* header = (BlockHeader*)malloc(kHeaderSize + GetClassSize(size_class));
+		if (header == nullptr)
+			return nullptr;
+
+		header->owner_ = &cache;
+		header->size_class_ = size_class;
+		header->size_ = 0;
+		return (uint8_t*)header + kHeaderSize;
+	}
+
+	void* Reallocate(void* ptr, size_t size) override
+	{
+		if (ptr == nullptr)
+			return Allocate(size);
+
+		BlockHeader* header = GetHeader(ptr);
+		uint32_t new_class = GetSizeClass(size);
+
+		//同一级别内伸缩不需要搬移
+		if (header->size_class_ != kLargeClass && new_class != kLargeClass && size <= GetClassSize(header->size_class_))
+			return ptr;
+
+		if (header->size_class_ == kLargeClass && new_class == kLargeClass)
+		{
+			BlockHeader* new_header = (BlockHeader*)realloc(header, kHeaderSize + size);
+			if (new_header == nullptr)
+				return nullptr;
+
+			new_header->size_ = (uint32_t)std::min<size_t>(size, UINT32_MAX);
+			return (uint8_t*)new_header + kHeaderSize;
+		}
+
+		void* new_ptr = Allocate(size);
+		if (new_ptr == nullptr)
+			return nullptr;
+
+		memcpy(new_ptr, ptr, std::min(GetUsableSize(ptr), size));
+		Deallocate(ptr);
+		return new_ptr;
+	}
+
+	void Deallocate(void* ptr) override
+	{
+		if (ptr == nullptr)
+			return;
+
+		BlockHeader* header = GetHeader(ptr);
+		if (header->size_class_ == kLargeClass)
+		{
+			free(header);
+			return;
+		}
+
+		ThreadCache* owner = header->owner_;
+		if (owner == LocalCache())
+		{
+			PushLocal(*owner, (FreeBlock*)ptr, header->size_class_);
+			return;
+		}
+
+		//别的线程分配的块还给它自己,避免在本线程堆积
+		//先加字节数再挂链表,保证remote_bytes_不小于链表上的实际字节数
+		owner->remote_bytes_.fetch_add(GetClassSize(header->size_class_), std::memory_order_relaxed);
+
+		FreeBlock* block = (FreeBlock*)ptr;
+		FreeBlock* head = owner->remote_.load(std::memory_order_relaxed);
+		do
+		{
+			block->next_ = head;
+		} while (!owner->remote_.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+
+		owner->remote_frees_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//块实际可用的字节数
+	static size_t GetUsableSize(void* ptr)
+	{
+		BlockHeader* header = GetHeader(ptr);
+		return header->size_class_ == kLargeClass ? header->size_ : GetClassSize(header->size_class_);
+	}
+
+	Stats GetStats()
+	{
+		Stats stats = Stats();
+		stats.large_allocations_ = large_allocations_.load(std::memory_order_relaxed);
+
+		Registry& registry = GetRegistry();
+		std::unique_lock<std::mutex> lock(registry.mutex_);
+		for (auto cache : registry.caches_)
+		{
+			stats.allocations_ += cache->allocations_.load(std::memory_order_relaxed);
+			stats.cache_hits_ += cache->cache_hits_.load(std::memory_order_relaxed);
+			stats.remote_frees_ += cache->remote_frees_.load(std::memory_order_relaxed);
+			stats.remote_pending_bytes_ += cache->remote_bytes_.load(std::memory_order_relaxed);
+			stats.cached_bytes_ += cache->cached_bytes_.load(std::memory_order_relaxed);
+		}
+		stats.thread_caches_ = registry.caches_.size();
+
+		return stats;
+	}
+
+private:
+	PoolAllocator() :large_allocations_(0) {}
+
+	struct ThreadCache;
+
+	//块前面的头,保证返回的地址16字节对齐
+	struct BlockHeader
+	{
+		ThreadCache* owner_;
+		uint32_t size_class_;
+		uint32_t size_;		//只有大块使用
+	};
+	static const size_t kHeaderSize = 16;
+	static_assert(sizeof(BlockHeader) <= kHeaderSize, "BlockHeader too large");
+
+	//空闲块复用数据区存放链表指针
+	struct FreeBlock
+	{
+		FreeBlock* next_;
+	};
+
+	struct ThreadCache
+	{
+		ThreadCache() :remote_(nullptr), remote_bytes_(0), allocations_(0), cache_hits_(0), remote_frees_(0), cached_bytes_(0)
+		{
+			for (uint32_t i = 0; i < kClassCount; ++i)
+			{
+				free_[i] = nullptr;
+				free_count_[i] = 0;
+			}
+		}
+
+		//只有所属线程访问
+		FreeBlock* free_[kClassCount];
+		uint32_t free_count_[kClassCount];
+
+		//其它线程归还的块
+		std::atomic<FreeBlock*> remote_;
+		std::atomic<size_t> remote_bytes_;
+
+		//统计只由所属线程写(remote_frees_除外),其它线程只读
+		std::atomic<uint64_t> allocations_;
+		std::atomic<uint64_t> cache_hits_;
+		std::atomic<uint64_t> remote_frees_;
+		std::atomic<uint64_t> cached_bytes_;
+	};
+
+	struct Registry
+	{
+		std::mutex mutex_;
+		std::vector<ThreadCache*> caches_;
+		std::vector<ThreadCache*> orphans_;	//所属线程已退出,等待复用
+	};
+
+	//线程退出时把缓存交回Registry
+	struct CacheHolder
+	{
+		CacheHolder() :cache_(nullptr) {}
+		~CacheHolder()
+		{
+			if (cache_ != nullptr)
+			{
+				Registry& registry = GetRegistry();
+				std::unique_lock<std::mutex> lock(registry.mutex_);
+				registry.orphans_.push_back(cache_);
+
+				//之后本线程其它thread_local对象析构时释放的块按跨线程归还处理
+				cache_ = nullptr;
+			}
+		}
+
+		ThreadCache* cache_;
+	};
+
+	//进程退出时线程缓存可能还在被引用,Registry和缓存都不释放
+	static Registry& GetRegistry()
+	{
+		static Registry* registry = new Registry();
+		return *registry;
+	}
+
+	static CacheHolder& GetHolder()
+	{
+		static thread_local CacheHolder holder;
+		return holder;
+	}
+
+	static ThreadCache* LocalCache()
+	{
+		return GetHolder().cache_;
+	}
+
+	static ThreadCache& GetLocalCache()
+	{
+		CacheHolder& holder = GetHolder();
+		if (holder.cache_ == nullptr)
+		{
+			Registry& registry = GetRegistry();
+			std::unique_lock<std::mutex> lock(registry.mutex_);
+			if (!registry.orphans_.empty())
+			{
+				holder.cache_ = registry.orphans_.back();
+				registry.orphans_.pop_back();
+			}
+			else
+			{
+				holder.cache_ = new ThreadCache();
+				registry.caches_.push_back(holder.cache_);
+			}
+		}
+
+		return *holder.cache_;
+	}
+
+	static uint32_t GetSizeClass(size_t size)
+	{
+		if (size > ((size_t)1 << kMaxClassShift))
+			return kLargeClass;
+
+		uint32_t size_class = 0;
+		while (((size_t)1 << (size_class + kMinClassShift)) < size)
+			++size_class;
+		return size_class;
+	}
+
+	static size_t GetClassSize(uint32_t size_class)
+	{
+		return (size_t)1 << (size_class + kMinClassShift);
+	}
+
+	static uint32_t GetMaxCachedBlocks(uint32_t size_class)
+	{
+		uint32_t blocks = (uint32_t)(kMaxCachedBytesPerClass / GetClassSize(size_class));
+		return blocks < kMinCachedBlocks ? kMinCachedBlocks : blocks;
+	}
+
+	static BlockHeader* GetHeader(void* ptr)
+	{
+		return (BlockHeader*)((uint8_t*)ptr - kHeaderSize);
+	}
+
+	static void Increase(std::atomic<uint64_t>& counter)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	void* AllocateLarge(size_t size)
+	{
+		BlockHeader* header = (BlockHeader*)malloc(kHeaderSize + size);
+		if (header == nullptr)
+			return nullptr;
+
+		header->owner_ = nullptr;
+		header->size_class_ = kLargeClass;
+		header->size_ = (uint32_t)std::min<size_t>(size, UINT32_MAX);
+		large_allocations_.fetch_add(1, std::memory_order_relaxed);
+		return (uint8_t*)header + kHeaderSize;
+	}
+
+	static void PushLocal(ThreadCache& cache, FreeBlock* block, uint32_t size_class)
+	{
+		if (cache.free_count_[size_class] >= GetMaxCachedBlocks(size_class))
+		{
+			free(GetHeader(block));
+			return;
+		}
+
+		block->next_ = cache.free_[size_class];
+		cache.free_[size_class] = block;
+		++cache.free_count_[size_class];
+		cache.cached_bytes_.store(cache.cached_bytes_.load(std::memory_order_relaxed) + GetClassSize(size_class), std::memory_order_relaxed);
+	}
+
+	static void DrainRemote(ThreadCache& cache)
+	{
+		FreeBlock* block = cache.remote_.exchange(nullptr, std::memory_order_acquire);
+		size_t bytes = 0;
+		while (block != nullptr)
+		{
+			FreeBlock* next = block->next_;
+			uint32_t size_class = GetHeader(block)->size_class_;
+			bytes += GetClassSize(size_class);
+			PushLocal(cache, block, size_class);
+			block = next;
+		}
+		cache.remote_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+
+	std::atomic<uint64_t> large_allocations_;
+};
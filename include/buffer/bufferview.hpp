@@ -0,0 +1,33 @@
+#pragma once
+#include<cstdint>
+#include<stdexcept>
+
+//不拥有内存的只读字节区间,只在回调期间有效
+class BufferView
+{
+public:
+	BufferView() :data_(nullptr), size_(0) {}
+	BufferView(const uint8_t* data, uint32_t size) :data_(data), size_(size) {}
+
+public:
+	const uint8_t* GetData() const { return data_; }
+	uint32_t GetSize() const { return size_; }
+	bool Empty() const { return size_ == 0; }
+
+	const uint8_t* begin() const { return data_; }
+	const uint8_t* end() const { return data_ + size_; }
+
+	uint8_t operator[](uint32_t pos) const { return data_[pos]; }
+
+	BufferView SubView(uint32_t offset, uint32_t len) const
+	{
+		if (offset > size_ || len > size_ - offset)
+			throw std::runtime_error("SubView exception:Invalid range");
+
+		return BufferView(data_ + offset, len);
+	}
+
+private:
+	const uint8_t* data_;
+	uint32_t size_;
+};
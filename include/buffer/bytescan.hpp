@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string.h>
+
+//SSE2/AVX2向量化的字节查找,编译器没有打开对应指令集时退回逐字节比较
+#if defined(__AVX2__)
+#	define BYTESCAN_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define BYTESCAN_SSE2
+#endif
+
+#if defined(BYTESCAN_AVX2)
+#	include <immintrin.h>
+#elif defined(BYTESCAN_SSE2)
+#	include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
+
+namespace bytescan
+{
+	inline uint32_t CountTrailingZeros(uint32_t mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (uint32_t)index;
+#else
+		return (uint32_t)__builtin_ctz(mask);
+#endif
+	}
+
+	inline uint32_t CountLeadingZeros(uint32_t mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse(&index, mask);
+		return 31 - (uint32_t)index;
+#else
+		return (uint32_t)__builtin_clz(mask);
+#endif
+	}
+
+	//在[begin,end)里查找value,找不到返回nullptr
+	inline const uint8_t* FindByte(const uint8_t* begin, const uint8_t* end, uint8_t value)
+	{
+		const uint8_t* p = begin;
+
+#if defined(BYTESCAN_AVX2)
+		const __m256i needle32 = _mm256_set1_epi8((char)value);
+		while (end - p >= 32)
+		{
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle32));
+			if (mask != 0)
+				return p + CountTrailingZeros(mask);
+			p += 32;
+		}
+#endif
+
+#if defined(BYTESCAN_SSE2)
+		const __m128i needle16 = _mm_set1_epi8((char)value);
+		while (end - p >= 16)
+		{
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16));
+			if (mask != 0)
+				return p + CountTrailingZeros(mask);
+			p += 16;
+		}
+#endif
+
+		for (; p < end; ++p)
+		{
+			if (*p == value)
+				return p;
+		}
+
+		return nullptr;
+	}
+
+	//在[begin,end)里查找多字节分隔符,找不到返回nullptr
+	inline const uint8_t* FindBytes(const uint8_t* begin, const uint8_t* end, const uint8_t* pattern, size_t pattern_size)
+	{
+		if (pattern_size == 0 || (size_t)(end - begin) < pattern_size)
+			return nullptr;
+
+		//分隔符只可能从last之前开始
+		const uint8_t* last = end - pattern_size + 1;
+		const uint8_t* p = begin;
+		while (p < last)
+		{
+			p = FindByte(p, last, pattern[0]);
+			if (p == nullptr)
+				return nullptr;
+
+			if (memcmp(p + 1, pattern + 1, pattern_size - 1) == 0)
+				return p;
+			++p;
+		}
+
+		return nullptr;
+	}
+
+	//去掉[begin,end)尾部的空格和'\0',返回去掉之后的end
+	inline const uint8_t* TrimRight(const uint8_t* begin, const uint8_t* end)
+	{
+		const uint8_t* p = end;
+
+#if defined(BYTESCAN_AVX2)
+		const __m256i space32 = _mm256_set1_epi8(' ');
+		const __m256i zero32 = _mm256_setzero_si256();
+		while (p - begin >= 32)
+		{
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p - 32));
+			__m256i pad = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space32), _mm256_cmpeq_epi8(chunk, zero32));
+			uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(pad);
+			if (mask != 0)
+				return p - 32 + (32 - CountLeadingZeros(mask));
+			p -= 32;
+		}
+#endif
+
+#if defined(BYTESCAN_SSE2)
+		const __m128i space16 = _mm_set1_epi8(' ');
+		const __m128i zero16 = _mm_setzero_si128();
+		while (p - begin >= 16)
+		{
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p - 16));
+			__m128i pad = _mm_or_si128(_mm_cmpeq_epi8(chunk, space16), _mm_cmpeq_epi8(chunk, zero16));
+			uint32_t mask = ~(uint32_t)_mm_movemask_epi8(pad) & 0xFFFF;
+			if (mask != 0)
+				return p - 16 + (32 - CountLeadingZeros(mask));
+			p -= 16;
+		}
+#endif
+
+		while (p > begin && (p[-1] == ' ' || p[-1] == 0))
+			--p;
+
+		return p;
+	}
+}
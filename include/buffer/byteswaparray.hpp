@@ -0,0 +1,256 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string.h>
+#include "endianconversion.hpp"
+
+//16/32/64位整数数组的批量字节序转换
+//x86上运行时检测CPU,依次选择AVX2/SSSE3的pshufb内核,其它平台用逐个bswap
+//src和dst可以相同(原地转换),不要求对齐
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	define BYTESWAP_X86
+#	define BYTESWAP_TARGET(isa) __attribute__((target(isa)))
+#	include <immintrin.h>
+#	include <cpuid.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#	define BYTESWAP_X86
+#	define BYTESWAP_TARGET(isa)
+#	include <immintrin.h>
+#	include <intrin.h>
+#endif
+
+namespace endian
+{
+	namespace detail
+	{
+		template<size_t kWidth>
+		struct ScalarSwapper;
+
+		template<>
+		struct ScalarSwapper<2>
+		{
+			static void Apply(uint8_t* dst, const uint8_t* src, size_t count)
+			{
+				for (size_t i = 0; i < count; ++i)
+				{
+					uint16_t value;
+					memcpy(&value, src + i * 2, 2);
+					value = ByteSwap16(value);
+					memcpy(dst + i * 2, &value, 2);
+				}
+			}
+		};
+
+		template<>
+		struct ScalarSwapper<4>
+		{
+			static void Apply(uint8_t* dst, const uint8_t* src, size_t count)
+			{
+				for (size_t i = 0; i < count; ++i)
+				{
+					uint32_t value;
+					memcpy(&value, src + i * 4, 4);
+					value = ByteSwap32(value);
+					memcpy(dst + i * 4, &value, 4);
+				}
+			}
+		};
+
+		template<>
+		struct ScalarSwapper<8>
+		{
+			static void Apply(uint8_t* dst, const uint8_t* src, size_t count)
+			{
+				for (size_t i = 0; i < count; ++i)
+				{
+					uint64_t value;
+					memcpy(&value, src + i * 8, 8);
+					value = ByteSwap64(value);
+					memcpy(dst + i * 8, &value, 8);
+				}
+			}
+		};
+
+#if defined(BYTESWAP_X86)
+		//pshufb的字节重排表,每个元素内部倒序,两个128位通道相同
+		template<size_t kWidth>
+		struct ShuffleTable
+		{
+			ShuffleTable()
+			{
+				for (size_t i = 0; i < 32; ++i)
+				{
+					size_t offset = i % 16;
+					mask_[i] = (uint8_t)(offset / kWidth * kWidth + (kWidth - 1 - offset % kWidth));
+				}
+			}
+
+			alignas(32) uint8_t mask_[32];
+		};
+
+		template<size_t kWidth>
+		inline const uint8_t* GetShuffleMask()
+		{
+			static const ShuffleTable<kWidth> table;
+			return table.mask_;
+		}
+
+		template<size_t kWidth>
+		BYTESWAP_TARGET("ssse3")
+		void SwapSsse3(uint8_t* dst, const uint8_t* src, size_t count)
+		{
+			const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(GetShuffleMask<kWidth>()));
+			size_t bytes = count * kWidth;
+			size_t i = 0;
+			for (; i + 16 <= bytes; i += 16)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(v, mask));
+			}
+
+			ScalarSwapper<kWidth>::Apply(dst + i, src + i, (bytes - i) / kWidth);
+		}
+
+		template<size_t kWidth>
+		BYTESWAP_TARGET("avx2")
+		void SwapAvx2(uint8_t* dst, const uint8_t* src, size_t count)
+		{
+			//vpshufb按128位通道各自重排,两个通道用同一张表
+			const __m256i mask = _mm256_load_si256(reinterpret_cast<const __m256i*>(GetShuffleMask<kWidth>()));
+			size_t bytes = count * kWidth;
+			size_t i = 0;
+			for (; i + 64 <= bytes; i += 64)
+			{
+				__m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+				__m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(v0, mask));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), _mm256_shuffle_epi8(v1, mask));
+			}
+			for (; i + 32 <= bytes; i += 32)
+			{
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(v, mask));
+			}
+
+			ScalarSwapper<kWidth>::Apply(dst + i, src + i, (bytes - i) / kWidth);
+		}
+
+		enum class SimdLevel
+		{
+			kScalar = 0,
+			kSsse3,
+			kAvx2
+		};
+
+		inline SimdLevel DetectSimdLevel()
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			int max_leaf = info[0];
+
+			__cpuid(info, 1);
+			bool ssse3 = (info[2] & (1 << 9)) != 0;
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+
+			bool avx2 = false;
+			if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+			{
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+#else
+			__builtin_cpu_init();
+			bool ssse3 = __builtin_cpu_supports("ssse3");
+			bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+			if (avx2)
+				return SimdLevel::kAvx2;
+			if (ssse3)
+				return SimdLevel::kSsse3;
+			return SimdLevel::kScalar;
+		}
+
+		inline SimdLevel GetSimdLevel()
+		{
+			static const SimdLevel level = DetectSimdLevel();
+			return level;
+		}
+#endif
+
+		template<size_t kWidth>
+		inline void SwapArray(void* dst, const void* src, size_t count)
+		{
+			uint8_t* d = static_cast<uint8_t*>(dst);
+			const uint8_t* s = static_cast<const uint8_t*>(src);
+
+#if defined(BYTESWAP_X86)
+			//元素太少时直接走标量,省掉一次分派
+			if (count * kWidth >= 32)
+			{
+				switch (GetSimdLevel())
+				{
+				case SimdLevel::kAvx2:
+					SwapAvx2<kWidth>(d, s, count);
+					return;
+				case SimdLevel::kSsse3:
+					SwapSsse3<kWidth>(d, s, count);
+					return;
+				default:
+					break;
+				}
+			}
+#endif
+			ScalarSwapper<kWidth>::Apply(d, s, count);
+		}
+
+		template<size_t kWidth>
+		inline void CopyArray(void* dst, const void* src, size_t count)
+		{
+			if (dst != src && count != 0)
+				memmove(dst, src, count * kWidth);
+		}
+	}
+
+	//count个sizeof(T)字节的整数,逐个反转字节序
+	template<typename T>
+	void SwapArray(void* dst, const void* src, size_t count)
+	{
+		static_assert(std::is_integral<T>::value && (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8), "must be 16/32/64-bit Integer .");
+		detail::SwapArray<sizeof(T)>(dst, src, count);
+	}
+
+	template<typename T>
+	void HToBeArray(void* dst, const void* src, size_t count)
+	{
+#if defined SYSTEM_LITTLE_ENDIAN
+		SwapArray<T>(dst, src, count);
+#elif defined SYSTEM_BIG_ENDIAN
+		detail::CopyArray<sizeof(T)>(dst, src, count);
+#endif
+	}
+
+	template<typename T>
+	void BeToHArray(void* dst, const void* src, size_t count)
+	{
+		HToBeArray<T>(dst, src, count);
+	}
+
+	template<typename T>
+	void HToLeArray(void* dst, const void* src, size_t count)
+	{
+#if defined SYSTEM_LITTLE_ENDIAN
+		detail::CopyArray<sizeof(T)>(dst, src, count);
+#elif defined SYSTEM_BIG_ENDIAN
+		SwapArray<T>(dst, src, count);
+#endif
+	}
+
+	template<typename T>
+	void LeToHArray(void* dst, const void* src, size_t count)
+	{
+		HToLeArray<T>(dst, src, count);
+	}
+}
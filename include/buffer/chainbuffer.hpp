@@ -0,0 +1,300 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+#include <string.h>
+#include "endianconversion.hpp"
+#include "bufferallocator.hpp"
+#include "bufferview.hpp"
+#include "databuffer.hpp"
+
+//分段缓冲区:由固定大小的段组成的链表
+//追加数据只会在末尾挂新段,已写入的数据不会被搬移,总长度不受uint32_t限制
+//读写接口和DataBuffer相同,发送时每段作为一个iovec直接writev,不需要拼接成连续内存
+class ChainBuffer
+{
+	struct Segment
+	{
+		Segment* next_;
+		uint32_t r_pos_;
+		uint32_t w_pos_;
+
+		uint8_t* GetData() { return reinterpret_cast<uint8_t*>(this + 1); }
+	};
+
+public:
+	//段大小包含段头,默认16K正好落在PoolAllocator的一个级别上
+	static const uint32_t kDefaultSegmentSize = 16 * 1024;
+
+	explicit ChainBuffer(uint32_t segment_size = kDefaultSegmentSize)
+		:head_(nullptr), tail_(nullptr), segment_capacity_(0), segment_count_(0), data_size_(0), allocator_(DataBuffer::GetDefaultAllocator())
+	{
+		if (segment_size <= sizeof(Segment) + 64)
+			throw std::invalid_argument("ChainBuffer Constructor exception:segment size too small");
+
+		segment_size_ = segment_size;
+		segment_capacity_ = segment_size - (uint32_t)sizeof(Segment);
+	}
+
+	ChainBuffer(const ChainBuffer&) = delete;
+	ChainBuffer& operator=(const ChainBuffer&) = delete;
+
+	ChainBuffer(ChainBuffer&& rhs) noexcept
+		:head_(rhs.head_), tail_(rhs.tail_), segment_size_(rhs.segment_size_), segment_capacity_(rhs.segment_capacity_)
+		, segment_count_(rhs.segment_count_), data_size_(rhs.data_size_), allocator_(rhs.allocator_)
+	{
+		rhs.head_ = rhs.tail_ = nullptr;
+		rhs.segment_count_ = 0;
+		rhs.data_size_ = 0;
+	}
+
+	ChainBuffer& operator=(ChainBuffer&& rhs) noexcept
+	{
+		if (&rhs != this)
+		{
+			Clear();
+			head_ = rhs.head_;
+			tail_ = rhs.tail_;
+			segment_size_ = rhs.segment_size_;
+			segment_capacity_ = rhs.segment_capacity_;
+			segment_count_ = rhs.segment_count_;
+			data_size_ = rhs.data_size_;
+			allocator_ = rhs.allocator_;
+
+			rhs.head_ = rhs.tail_ = nullptr;
+			rhs.segment_count_ = 0;
+			rhs.data_size_ = 0;
+		}
+		return *this;
+	}
+
+	~ChainBuffer()
+	{
+		Clear();
+	}
+
+public:
+	//buf为nullptr时只占用空间不拷贝数据
+	uint64_t Write(const void* buf, uint64_t len);
+	uint64_t Read(void* buf, uint64_t len);
+
+	template<typename T>
+	void WriteIntegerLE(T value)
+	{
+		static_assert(std::is_integral<T>::value, "must be Integer .");
+		endian::HToLe(value);
+		Write(&value, sizeof(value));
+	}
+
+	template<typename T>
+	void ReadIntegerLE(T& value)
+	{
+		static_assert(std::is_integral<T>::value, "must be Integer .");
+		Read(&value, sizeof(value));
+		endian::LeToH(value);
+	}
+
+	template<typename T>
+	void WriteIntegerBE(T value)
+	{
+		static_assert(std::is_integral<T>::value, "must be Integer .");
+		endian::HToBe(value);
+		Write(&value, sizeof(value));
+	}
+
+	template<typename T>
+	void ReadIntegerBE(T& value)
+	{
+		static_assert(std::is_integral<T>::value, "must be Integer .");
+		Read(&value, sizeof(value));
+		endian::BeToH(value);
+	}
+
+	template<typename ARRAY>
+	typename std::enable_if<std::is_array<ARRAY>::value, void>::type
+		WriteArray(const ARRAY& a)
+	{
+		static_assert(sizeof(typename std::remove_extent<ARRAY>::type) == 1 && std::is_integral<typename std::remove_extent<ARRAY>::type>::value,
+			"must be int8_t or uint8_t or char or unsigned char Array  .");
+		Write(a, std::extent<ARRAY>::value);
+	}
+
+	template<typename ARRAY>
+	typename std::enable_if<std::is_array<ARRAY>::value, void>::type
+		ReadArray(ARRAY& a)
+	{
+		static_assert(sizeof(typename std::remove_extent<ARRAY>::type) == 1 && std::is_integral<typename std::remove_extent<ARRAY>::type>::value,
+			"must be int8_t or uint8_t or char or unsigned char Array  .");
+		Read(a, std::extent<ARRAY>::value);
+	}
+
+	template<typename POD>
+	void WritePod(const POD& pod)
+	{
+		static_assert(std::is_pod<POD>::value, "must be pod ");
+		Write(&pod, sizeof(pod));
+	}
+
+	template<typename POD>
+	void ReadPod(POD& pod)
+	{
+		static_assert(std::is_pod<POD>::value, "must be pod ");
+		Read(&pod, sizeof(pod));
+	}
+
+	uint64_t GetDataSize() const { return data_size_; }
+	bool Empty() const { return data_size_ == 0; }
+	uint32_t GetSegmentSize() const { return segment_size_; }
+	size_t GetSegmentCount() const { return segment_count_; }
+
+	void Clear();
+
+	//按顺序遍历每段的可读部分,跳过空段
+	class SegmentIterator
+	{
+	public:
+		explicit SegmentIterator(Segment* segment = nullptr) :segment_(segment) { SkipEmpty(); }
+
+		BufferView operator*() const { return BufferView(segment_->GetData() + segment_->r_pos_, segment_->w_pos_ - segment_->r_pos_); }
+		SegmentIterator& operator++() { segment_ = segment_->next_; SkipEmpty(); return *this; }
+		bool operator==(const SegmentIterator& rhs) const { return segment_ == rhs.segment_; }
+		bool operator!=(const SegmentIterator& rhs) const { return segment_ != rhs.segment_; }
+
+	private:
+		void SkipEmpty()
+		{
+			while (segment_ != nullptr && segment_->r_pos_ == segment_->w_pos_)
+				segment_ = segment_->next_;
+		}
+
+		Segment* segment_;
+	};
+
+	struct SegmentRange
+	{
+		SegmentIterator begin() const { return first_; }
+		SegmentIterator end() const { return SegmentIterator(); }
+
+		SegmentIterator first_;
+	};
+
+	//段的生命周期和ChainBuffer相同,移动ChainBuffer不会使已取到的BufferView失效
+	SegmentRange GetSegments() const { return SegmentRange{ SegmentIterator(head_) }; }
+
+private:
+	Segment* AppendSegment();
+	void PopSegment();
+
+	Segment* head_;
+	Segment* tail_;
+	uint32_t segment_size_;
+	uint32_t segment_capacity_;	//每段可存放的数据字节数
+	size_t segment_count_;
+	uint64_t data_size_;
+	BufferAllocator* allocator_;
+};
+
+inline uint64_t ChainBuffer::Write(const void* buf, uint64_t len)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(buf);
+	uint64_t left = len;
+	while (left != 0)
+	{
+		Segment* segment = tail_;
+		if (segment == nullptr || segment->w_pos_ == segment_capacity_)
+			segment = AppendSegment();
+
+		uint32_t n = (uint32_t)std::min<uint64_t>(left, segment_capacity_ - segment->w_pos_);
+		if (src != nullptr)
+		{
+			memcpy(segment->GetData() + segment->w_pos_, src, n);
+			src += n;
+		}
+
+		segment->w_pos_ += n;
+		data_size_ += n;
+		left -= n;
+	}
+
+	return len;
+}
+
+inline uint64_t ChainBuffer::Read(void* buf, uint64_t len)
+{
+	if (len > data_size_)
+		throw std::runtime_error("Read exception:Read data length exceeds buffer size");
+
+	uint8_t* dst = static_cast<uint8_t*>(buf);
+	uint64_t left = len;
+	while (left != 0)
+	{
+		Segment* segment = head_;
+		uint32_t n = (uint32_t)std::min<uint64_t>(left, segment->w_pos_ - segment->r_pos_);
+		if (dst != nullptr)
+		{
+			memcpy(dst, segment->GetData() + segment->r_pos_, n);
+			dst += n;
+		}
+
+		segment->r_pos_ += n;
+		data_size_ -= n;
+		left -= n;
+
+		if (segment->r_pos_ == segment->w_pos_)
+			PopSegment();
+	}
+
+	return len;
+}
+
+inline void ChainBuffer::Clear()
+{
+	while (head_ != nullptr)
+	{
+		Segment* segment = head_;
+		head_ = segment->next_;
+		allocator_->Deallocate(segment);
+	}
+
+	tail_ = nullptr;
+	segment_count_ = 0;
+	data_size_ = 0;
+}
+
+inline ChainBuffer::Segment* ChainBuffer::AppendSegment()
+{
+	Segment* segment = static_cast<Segment*>(allocator_->Allocate(segment_size_));
+	if (segment == nullptr)
+		throw std::runtime_error("AppendSegment exception:Memory allocation failure");
+
+	segment->next_ = nullptr;
+	segment->r_pos_ = 0;
+	segment->w_pos_ = 0;
+
+	if (tail_ != nullptr)
+		tail_->next_ = segment;
+	else
+		head_ = segment;
+	tail_ = segment;
+	++segment_count_;
+
+	return segment;
+}
+
+//读完的段立即释放,最后一段保留给后续写入
+inline void ChainBuffer::PopSegment()
+{
+	Segment* segment = head_;
+	if (segment == tail_)
+	{
+		segment->r_pos_ = 0;
+		segment->w_pos_ = 0;
+		return;
+	}
+
+	head_ = segment->next_;
+	--segment_count_;
+	allocator_->Deallocate(segment);
+}
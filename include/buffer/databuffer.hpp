@@ -2,20 +2,30 @@
 #include<cstdint>
 #include<stdexcept>
 #include<string.h>
+#include<string>
+#include<algorithm>
 #include "endianconversion.hpp"
+#include "byteswaparray.hpp"
+#include "varint.hpp"
+#include "bufferview.hpp"
+#include "ringmemory.hpp"
+#include "bufferallocator.hpp"
 
 class DataBuffer
 {
 public:
-	DataBuffer() :bufeer_(nullptr), capacity_(0), r_pos_(0), w_pos_(0), copy_data_(true) {}
-	DataBuffer(uint32_t capacity) :bufeer_((uint8_t*)malloc(capacity)), capacity_(capacity), r_pos_(0), w_pos_(0), copy_data_(true)
+	DataBuffer() :bufeer_(nullptr), capacity_(0), r_pos_(0), w_pos_(0), copy_data_(true), ring_(false), allocator_(GetDefaultAllocator()) {}
+	DataBuffer(uint32_t capacity) :bufeer_(nullptr), capacity_(capacity), r_pos_(0), w_pos_(0), copy_data_(true), ring_(false), allocator_(GetDefaultAllocator())
 	{
+		if (capacity != 0)
+			bufeer_ = (uint8_t*)allocator_->Allocate(capacity);
+
 		if (bufeer_ == nullptr&&capacity!=0)
 		{
 			throw std::runtime_error("DataBuffer Constructor exception: Memory allocation failure");
 		}
 	}
-	DataBuffer(uint8_t* data, uint32_t size, bool copy_data = true, bool write_pos_to_end = true) :copy_data_(copy_data)
+	DataBuffer(uint8_t* data, uint32_t size, bool copy_data = true, bool write_pos_to_end = true) :copy_data_(copy_data), ring_(false), allocator_(GetDefaultAllocator())
 	{
 		if (copy_data_)
 		{
@@ -46,15 +56,27 @@ public:
 		w_pos_ = rhs.w_pos_;
 
 		copy_data_ = rhs.copy_data_;
+		ring_ = false;
+		allocator_ = rhs.allocator_;
 		ExtendTo(capacity_);
 
-		memcpy(bufeer_, rhs.bufeer_, rhs.w_pos_);
+		CopyFrom(rhs);
 	}
 
 	DataBuffer& operator=(const DataBuffer &rhs)
 	{
 		if (&rhs != this)
 		{
+			//еĻŵʱֱӸ,·
+			if (copy_data_ && rhs.copy_data_ && !ring_ && bufeer_ != nullptr && capacity_ >= rhs.capacity_)
+			{
+				capacity_ = rhs.capacity_;
+				r_pos_ = rhs.r_pos_;
+				w_pos_ = rhs.w_pos_;
+				CopyFrom(rhs);
+				return *this;
+			}
+
 			Free();
 			capacity_ = rhs.capacity_;
 
@@ -62,26 +84,30 @@ public:
 			w_pos_ = rhs.w_pos_;
 
 			copy_data_ = rhs.copy_data_;
+			allocator_ = rhs.allocator_;
 			ExtendTo(capacity_);
-			memcpy(bufeer_, rhs.bufeer_, rhs.w_pos_);
+			CopyFrom(rhs);
 		}
 		return *this;
 	}
 
-	DataBuffer(DataBuffer &&rhs)
+	DataBuffer(DataBuffer &&rhs) noexcept
 	{
 	
 		capacity_ = rhs.capacity_;
 		r_pos_ = rhs.r_pos_;
 		w_pos_ = rhs.w_pos_;
 		copy_data_ = rhs.copy_data_;
+		ring_ = rhs.ring_;
+		allocator_ = rhs.allocator_;
 		bufeer_ = rhs.bufeer_;
 
 		rhs.capacity_ = rhs.r_pos_ = rhs.w_pos_ = 0;
 		rhs.bufeer_ = nullptr;
+		rhs.ring_ = false;
 	}
 
-	DataBuffer& operator=(DataBuffer &&rhs)
+	DataBuffer& operator=(DataBuffer &&rhs) noexcept
 	{
 		if (&rhs != this)
 		{
@@ -90,10 +116,13 @@ public:
 			r_pos_ = rhs.r_pos_;
 			w_pos_ = rhs.w_pos_;
 			copy_data_ = rhs.copy_data_;
+			ring_ = rhs.ring_;
+			allocator_ = rhs.allocator_;
 			bufeer_ = rhs.bufeer_;
 
 			rhs.capacity_ = rhs.r_pos_ = rhs.w_pos_ = 0;
 			rhs.bufeer_ = nullptr;
+			rhs.ring_ = false;
 		}
 		return *this;
 	}
@@ -142,6 +171,145 @@ public:
 		endian::BeToH(value);
 	}
 
+	//д16/32/64λ,һμ鳤,ֽתSIMD
+	template<typename T>
+	void WriteIntegerArrayLE(const T* values, uint32_t count)
+	{
+		uint32_t len = GetIntegerArrayLength<T>(count);
+		Write(nullptr, len);
+		endian::HToLeArray<T>(GetWritePtr() - len, values, count);
+	}
+
+	template<typename T>
+	void ReadIntegerArrayLE(T* values, uint32_t count)
+	{
+		uint32_t len = GetIntegerArrayLength<T>(count);
+		if (len > GetDataSize())
+			throw std::runtime_error("ReadIntegerArray exception:Read data length exceeds buffer size");
+
+		endian::LeToHArray<T>(values, GetReadPtr(), count);
+		Read(nullptr, len);
+	}
+
+	template<typename T>
+	void WriteIntegerArrayBE(const T* values, uint32_t count)
+	{
+		uint32_t len = GetIntegerArrayLength<T>(count);
+		Write(nullptr, len);
+		endian::HToBeArray<T>(GetWritePtr() - len, values, count);
+	}
+
+	template<typename T>
+	void ReadIntegerArrayBE(T* values, uint32_t count)
+	{
+		uint32_t len = GetIntegerArrayLength<T>(count);
+		if (len > GetDataSize())
+			throw std::runtime_error("ReadIntegerArray exception:Read data length exceeds buffer size");
+
+		endian::BeToHArray<T>(values, GetReadPtr(), count);
+		Read(nullptr, len);
+	}
+
+	//LEB128䳤,Сֵֻռ1~2ֽ
+	template<typename T>
+	void WriteVarint(T value)
+	{
+		static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "must be unsigned Integer .");
+		WriteVarintWire(value);
+	}
+
+	template<typename T>
+	void ReadVarint(T& value)
+	{
+		static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "must be unsigned Integer .");
+		if (!varint::FromWire(ReadVarintWire(), value, std::false_type()))
+			throw std::runtime_error("ReadVarint exception:Value out of range");
+	}
+
+	//зzigzag,ֵСĸҲֻռ1~2ֽ
+	template<typename T>
+	void WriteZigZag(T value)
+	{
+		static_assert(std::is_integral<T>::value && std::is_signed<T>::value, "must be signed Integer .");
+		WriteVarintWire(varint::ZigZagEncode(value));
+	}
+
+	template<typename T>
+	void ReadZigZag(T& value)
+	{
+		static_assert(std::is_integral<T>::value && std::is_signed<T>::value, "must be signed Integer .");
+		if (!varint::FromWire(ReadVarintWire(), value, std::true_type()))
+			throw std::runtime_error("ReadZigZag exception:Value out of range");
+	}
+
+	//䳤,зͰzigzag,дԪظ
+	template<typename T>
+	void WriteVarintArray(const T* values, uint32_t count)
+	{
+		static_assert(std::is_integral<T>::value, "must be Integer .");
+		uint64_t max_len = (uint64_t)count * varint::MaxSize<T>::value + varint::kMaxVarintSize;
+		if (max_len > UINT32_MAX)
+			throw std::runtime_error("WriteVarintArray exception:Array too large");
+
+		if (GetAvailableSize() < max_len)
+		{
+			if (!copy_data_)
+			{
+				for (uint32_t i = 0; i < count; ++i)
+					WriteVarintWire(varint::ToWire(values[i], std::is_signed<T>()));
+				return;
+			}
+			Extend((uint32_t)max_len);
+		}
+
+		uint8_t* end = varint::EncodeArray(GetWritePtr(), values, count);
+		w_pos_ = (uint32_t)(end - bufeer_);
+	}
+
+	template<typename T>
+	void ReadVarintArray(T* values, uint32_t count)
+	{
+		static_assert(std::is_integral<T>::value, "must be Integer .");
+		const uint8_t* end = varint::DecodeArray(GetReadPtr(), GetReadPtr() + GetDataSize(), values, count);
+		if (end == nullptr)
+			throw std::runtime_error("ReadVarintArray exception:Invalid or truncated varint");
+
+		Read(nullptr, (uint32_t)(end - GetReadPtr()));
+	}
+
+	//(varint)+
+	void WriteBytesField(const void* data, uint32_t len)
+	{
+		WriteVarintWire(len);
+		Write(const_cast<void*>(data), len);
+	}
+
+	void WriteBytesField(const std::string& str)
+	{
+		if (str.size() > UINT32_MAX)
+			throw std::runtime_error("WriteBytesField exception:Data too large");
+		WriteBytesField(str.data(), (uint32_t)str.size());
+	}
+
+	//viewָ򻺳ڲ,ٴд֮ǰЧ;ݲʱƶλ
+	void ReadBytesField(BufferView& view)
+	{
+		uint64_t len;
+		uint32_t n = varint::Decode(GetReadPtr(), GetDataSize(), len);
+		if (n == 0 || len > GetDataSize() - n)
+			throw std::runtime_error("ReadBytesField exception:Invalid or truncated field");
+
+		view = BufferView(GetReadPtr() + n, (uint32_t)len);
+		Read(nullptr, n + (uint32_t)len);
+	}
+
+	void ReadBytesField(std::string& str)
+	{
+		BufferView view;
+		ReadBytesField(view);
+		str.assign(reinterpret_cast<const char*>(view.GetData()), view.GetSize());
+	}
+
 	template<typename ARRAY>
 	typename std::enable_if<std::is_array<ARRAY>::value, void>::type
 		WriteArray(const ARRAY& a)
@@ -195,12 +363,23 @@ public:
 
 	void Adjustment();
 
+	//лΪλ:ͬһڴӳ,ɶݿԽĩβʱַȻ,Adjustmentmemmove
+	//ҳ(Windows64K)ȡ,ƽֻ̨֧ӳʧʱfalse,ֲ
+	bool EnableRing(uint32_t capacity);
+	bool IsRing() { return ring_; }
+
+	//֮󴴽DataBufferʹõķ,ĬPoolAllocator,еDataBufferʹôʱķ
+	static void SetDefaultAllocator(BufferAllocator* allocator) { DefaultAllocator().store(allocator != nullptr ? allocator : &PoolAllocator::Instance()); }
+	static BufferAllocator* GetDefaultAllocator() { return DefaultAllocator().load(std::memory_order_relaxed); }
+	BufferAllocator* GetAllocator() { return allocator_; }
+
 	uint8_t* GetReadPtr() { return bufeer_ + r_pos_; }
 	void SetReadPtr(uint8_t* ptr)
 	{
-		if (ptr >= bufeer_&&ptr <= bufeer_ + capacity_)
+		if (ptr >= bufeer_&&ptr <= bufeer_ + GetPosLimit())
 		{
 			r_pos_ = uint32_t(ptr - bufeer_);
+			Fold();
 		}
 		else
 		{
@@ -210,9 +389,10 @@ public:
 	uint32_t GetReadPos() { return r_pos_; }
 	void SetReadPos(uint32_t pos)
 	{
-		if (pos <= capacity_)
+		if (pos <= GetPosLimit())
 		{
 			r_pos_ = pos;
+			Fold();
 		}
 		else
 		{
@@ -222,7 +402,7 @@ public:
 	uint8_t* GetWritePtr() { return bufeer_ + w_pos_; }
 	void SetWritePtr(uint8_t* ptr)
 	{
-		if (ptr >= bufeer_&&ptr <= bufeer_ + capacity_)
+		if (ptr >= bufeer_&&ptr <= bufeer_ + GetPosLimit())
 		{
 			w_pos_ = (uint32_t)(ptr - bufeer_);
 		}
@@ -234,7 +414,7 @@ public:
 	uint32_t GetWritePos() { return w_pos_; }
 	void SetWritePos(uint32_t pos)
 	{
-		if (pos <= capacity_)
+		if (pos <= GetPosLimit())
 		{
 			w_pos_ = pos;
 		}
@@ -246,9 +426,14 @@ public:
 
 	uint32_t GetDataSize() { return  w_pos_ - r_pos_; }
 	uint32_t GetCapacitySize() { return capacity_; }
-	uint32_t GetAvailableSize() { return capacity_ - w_pos_; }
+	uint32_t GetAvailableSize() { return ring_ ? capacity_ - (w_pos_ - r_pos_) : capacity_ - w_pos_; }
 	void SetCapacitySize(uint32_t size)
 	{
+		if (ring_)
+		{
+			RingExtendTo(size);
+			return;
+		}
 
 		capacity_ = size;
 		ExtendTo(capacity_);
@@ -265,7 +450,7 @@ protected:
 		if (!copy_data_)
 			throw std::runtime_error("ExtendTo exception:Automatic allocation of memory is not supported");
 
-		uint8_t* new_buf = (uint8_t*)realloc(bufeer_, len);
+		uint8_t* new_buf = (uint8_t*)allocator_->Reallocate(bufeer_, len);
 		if (new_buf != nullptr)
 		{
 			bufeer_ = new_buf;
@@ -279,13 +464,80 @@ protected:
 	{
 		if (copy_data_&&bufeer_ != nullptr)
 		{
-			free(bufeer_);
+			if (ring_)
+				ringmemory::Free(bufeer_, capacity_);
+			else
+				allocator_->Deallocate(bufeer_);
 			bufeer_ = nullptr;
 			capacity_ = 0;
 			w_pos_ = 0;
 			r_pos_ = 0;
 		}
+		ring_ = false;
+	}
+
+	//ģʽλÿԵ2*capacity_(ڶӳ)
+	uint32_t GetPosLimit() { return ring_ ? capacity_ * 2 : capacity_; }
+
+	//ģʽ¶λýڶӳ,дλһȥcapacity_,֤r_pos_ < capacity_
+	void Fold()
+	{
+		if (ring_ && r_pos_ >= capacity_)
+		{
+			r_pos_ -= capacity_;
+			w_pos_ -= capacity_;
+		}
+	}
+
+	void RingExtendTo(uint32_t len);
+
+	//rhs,λֻɶ
+	void CopyFrom(const DataBuffer& rhs)
+	{
+		if (rhs.ring_)
+		{
+			r_pos_ = 0;
+			w_pos_ = rhs.w_pos_ - rhs.r_pos_;
+			memcpy(bufeer_, rhs.bufeer_ + rhs.r_pos_, w_pos_);
+		}
+		else
+		{
+			memcpy(bufeer_, rhs.bufeer_, rhs.w_pos_);
+		}
+	}
+private:
+	void WriteVarintWire(uint64_t value)
+	{
+		if (GetAvailableSize() >= varint::kMaxVarintSize)
+		{
+			w_pos_ += varint::EncodeFast(GetWritePtr(), value);
+			return;
+		}
+
+		uint8_t tmp[varint::kMaxVarintSize];
+		Write(tmp, varint::Encode(tmp, value));
+	}
+
+	uint64_t ReadVarintWire()
+	{
+		uint64_t value;
+		uint32_t n = varint::Decode(GetReadPtr(), GetDataSize(), value);
+		if (n == 0)
+			throw std::runtime_error("ReadVarint exception:Invalid or truncated varint");
+
+		Read(nullptr, n);
+		return value;
 	}
+
+	template<typename T>
+	static uint32_t GetIntegerArrayLength(uint32_t count)
+	{
+		static_assert(std::is_integral<T>::value && (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8), "must be 16/32/64-bit Integer .");
+		if (count > UINT32_MAX / sizeof(T))
+			throw std::runtime_error("IntegerArray exception:Array too large");
+		return count * (uint32_t)sizeof(T);
+	}
+
 private:
 	uint8_t* bufeer_;//ָ
 	uint32_t capacity_;//ĿռС
@@ -294,11 +546,19 @@ private:
 	uint32_t w_pos_;//дλ
 
 	bool copy_data_;
+	bool ring_;
+	BufferAllocator* allocator_;
+
+	static std::atomic<BufferAllocator*>& DefaultAllocator()
+	{
+		static std::atomic<BufferAllocator*> allocator(&PoolAllocator::Instance());
+		return allocator;
+	}
 };
 
 inline uint32_t DataBuffer::Write(void* buf, uint32_t len)
 {
-	if (w_pos_ + len > capacity_)
+	if (ring_ ? w_pos_ - r_pos_ + len > capacity_ : w_pos_ + len > capacity_)
 	{
 		Extend(len);
 	}
@@ -322,6 +582,7 @@ inline uint32_t DataBuffer::Read(void* buf, uint32_t len)
 		memcpy(buf, bufeer_ + r_pos_, len);
 
 	r_pos_ += len;
+	Fold();
 
 	return len;
 }
@@ -330,6 +591,12 @@ inline uint32_t DataBuffer::Read(void* buf, uint32_t len)
 
 inline void DataBuffer::Adjustment()
 {
+	if (ring_)
+	{
+		Fold();
+		return;
+	}
+
 	if (r_pos_ != 0)
 	{
 		memmove(bufeer_, bufeer_ + r_pos_, w_pos_ - r_pos_);
@@ -340,7 +607,71 @@ inline void DataBuffer::Adjustment()
 
 inline void DataBuffer::Extend(uint32_t len)
 {
+	if (ring_)
+	{
+		uint32_t size = w_pos_ - r_pos_ + len;
+		RingExtendTo(size + (size >> 2));
+		return;
+	}
+
 	capacity_ = w_pos_ + len;
 	capacity_ += capacity_ >> 2;
 	ExtendTo(capacity_);
 }
+
+inline bool DataBuffer::EnableRing(uint32_t capacity)
+{
+	if (!copy_data_)
+		return false;
+
+	if (ring_)
+	{
+		RingExtendTo(capacity);
+		return true;
+	}
+
+	uint32_t data_size = w_pos_ - r_pos_;
+	size_t size = ringmemory::RoundUp(std::max(capacity, data_size));
+	if (size > UINT32_MAX / 2)
+		return false;
+
+	uint8_t* ring = ringmemory::Allocate(size);
+	if (ring == nullptr)
+		return false;
+
+	if (data_size != 0)
+		memcpy(ring, bufeer_ + r_pos_, data_size);
+
+	Free();
+	bufeer_ = ring;
+	capacity_ = (uint32_t)size;
+	r_pos_ = 0;
+	w_pos_ = data_size;
+	ring_ = true;
+
+	return true;
+}
+
+//ӳһ黷ڴ,SetCapacitySizeһ,lenСݳʱض
+inline void DataBuffer::RingExtendTo(uint32_t len)
+{
+	size_t size = ringmemory::RoundUp(len);
+	if (size == capacity_)
+		return;
+
+	if (size > UINT32_MAX / 2)
+		throw std::runtime_error("RingExtendTo exception:Capacity too large");
+
+	uint8_t* ring = ringmemory::Allocate(size);
+	if (ring == nullptr)
+		throw std::runtime_error("RingExtendTo exception:Memory allocation failure");
+
+	uint32_t data_size = std::min<uint32_t>(w_pos_ - r_pos_, (uint32_t)size);
+	memcpy(ring, bufeer_ + r_pos_, data_size);
+
+	ringmemory::Free(bufeer_, capacity_);
+	bufeer_ = ring;
+	capacity_ = (uint32_t)size;
+	r_pos_ = 0;
+	w_pos_ = data_size;
+}
@@ -1,8 +1,15 @@
 #pragma once
 #include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <string.h>
 #include <algorithm>
 #include <type_traits>
 
+#if defined(_MSC_VER)
+#   include <stdlib.h>
+#endif
+
 #if defined (__GLIBC__)
 #   include <endian.h>
 #endif
@@ -151,70 +158,95 @@ namespace endian
 	#endif
 	}*/
 
-	template<typename T>
-	void Swap(T& out)
+	inline uint16_t ByteSwap16(uint16_t value)
 	{
-		static union autodetect
-		{
-			int word;
-			char byte[sizeof(int)];
-			autodetect() : word(1)
-			{
+#if defined(_MSC_VER)
+		return _byteswap_ushort(value);
+#else
+		return __builtin_bswap16(value);
+#endif
+	}
 
-#if defined SYSTEM_LITTLE_ENDIAN
-				assert(("wrong endianness detected!", byte[0] == 1));
-#elif defined SYSTEM_BIG_ENDIAN
-				assert(("wrong endianness detected!", byte[0] == 0))
+	inline uint32_t ByteSwap32(uint32_t value)
+	{
+#if defined(_MSC_VER)
+		return _byteswap_ulong(value);
+#else
+		return __builtin_bswap32(value);
 #endif
-			}
-		} _;
+	}
 
-		if (!std::is_pod<T>::value)
+	inline uint64_t ByteSwap64(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		return _byteswap_uint64(value);
+#else
+		return __builtin_bswap64(value);
+#endif
+	}
+
+	//ֽڱĺȷ,2/4/8ֱֽbswapָ,ֽڽ
+	template<size_t kSize>
+	struct Swapper
+	{
+		static void Apply(void* ptr)
 		{
-			//return out;
-			return;
+			char* bytes = static_cast<char*>(ptr);
+			std::reverse(bytes, bytes + kSize);
 		}
+	};
 
-		char *ptr = NULL;
+	template<>
+	struct Swapper<1>
+	{
+		static void Apply(void*) {}
+	};
 
-		switch (sizeof(T))
+	template<>
+	struct Swapper<2>
+	{
+		static void Apply(void* ptr)
 		{
-		case 0:
-		case 1:
-			break;
-		case 2:
-			ptr = reinterpret_cast<char *>(&out);
-			std::swap(ptr[0], ptr[1]);
-			break;
-		case 4:
-			ptr = reinterpret_cast<char *>(&out);
-			std::swap(ptr[0], ptr[3]);
-			std::swap(ptr[1], ptr[2]);
-			break;
-		case 8:
-			ptr = reinterpret_cast<char *>(&out);
-			std::swap(ptr[0], ptr[7]);
-			std::swap(ptr[1], ptr[6]);
-			std::swap(ptr[2], ptr[5]);
-			std::swap(ptr[3], ptr[4]);
-			break;
-		case 16:
-			ptr = reinterpret_cast<char *>(&out);
-			std::swap(ptr[0], ptr[15]);
-			std::swap(ptr[1], ptr[14]);
-			std::swap(ptr[2], ptr[13]);
-			std::swap(ptr[3], ptr[12]);
-			std::swap(ptr[4], ptr[11]);
-			std::swap(ptr[5], ptr[10]);
-			std::swap(ptr[6], ptr[9]);
-			std::swap(ptr[7], ptr[8]);
-			break;
-		default:
-			assert(!"POD type bigger than 256 bits (?)");
-			break;
+			uint16_t value;
+			memcpy(&value, ptr, sizeof(value));
+			value = ByteSwap16(value);
+			memcpy(ptr, &value, sizeof(value));
+		}
+	};
+
+	template<>
+	struct Swapper<4>
+	{
+		static void Apply(void* ptr)
+		{
+			uint32_t value;
+			memcpy(&value, ptr, sizeof(value));
+			value = ByteSwap32(value);
+			memcpy(ptr, &value, sizeof(value));
+		}
+	};
+
+	template<>
+	struct Swapper<8>
+	{
+		static void Apply(void* ptr)
+		{
+			uint64_t value;
+			memcpy(&value, ptr, sizeof(value));
+			value = ByteSwap64(value);
+			memcpy(ptr, &value, sizeof(value));
+		}
+	};
+
+	template<typename T>
+	void Swap(T& out)
+	{
+		if (!std::is_pod<T>::value)
+		{
+			return;
 		}
 
-		//return out;
+		Swapper<sizeof(T)>::Apply(&out);
 	}
 
 
@@ -264,7 +296,6 @@ namespace endian
 #if defined SYSTEM_LITTLE_ENDIAN
 		Swap(in);
 #elif defined SYSTEM_BIG_ENDIAN
-		in;
 #endif
 	}
 }
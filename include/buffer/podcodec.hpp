@@ -0,0 +1,319 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <array>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <string.h>
+#include "endianconversion.hpp"
+#include "databuffer.hpp"
+
+//定长报文的编解码:结构体声明一次字段描述,Encode/Decode按描述展开成逐字段的内存拷贝
+//整条报文只检查一次长度,字段偏移在编译期确定
+//
+//用法:
+//	struct Order
+//	{
+//		uint32_t id_;
+//		char symbol_[8];
+//		std::array<char, 12> account_;
+//		std::string remark_;
+//		Header header_;
+//
+//		static constexpr auto Fields()
+//		{
+//			return std::make_tuple(
+//				podcodec::IntegerBE(&Order::id_),
+//				podcodec::CharArray(&Order::symbol_, podcodec::StringRule::kSpacePadded),
+//				podcodec::CharArray(&Order::account_, podcodec::StringRule::kZeroPadded),
+//				podcodec::FixedString<32>(&Order::remark_, podcodec::StringRule::kSpacePadded),
+//				podcodec::Nested(&Order::header_));
+//		}
+//	};
+//
+//	podcodec::Encode(buffer, order);
+//	podcodec::Decode(buffer, order);
+//
+//不能修改的结构体可以特化podcodec::FieldsOf<T>,提供静态的Get()
+namespace podcodec
+{
+	//定长字符串的填充/截断规则
+	enum class StringRule
+	{
+		kRaw = 0,		//原样拷贝N个字节
+		kSpacePadded,	//编码时第一个'\0'之后补空格,解码时去掉尾部空格('\0'同样去掉)
+		kZeroPadded		//编码时第一个'\0'之后补'\0',解码时去掉尾部'\0'
+	};
+
+	template<typename T>
+	struct FieldsOf
+	{
+		static constexpr auto Get() -> decltype(T::Fields())
+		{
+			return T::Fields();
+		}
+	};
+
+	namespace detail
+	{
+		template<uint32_t... kSizes>
+		struct SizeSum;
+
+		template<>
+		struct SizeSum<> : std::integral_constant<uint32_t, 0> {};
+
+		template<uint32_t kFirst, uint32_t... kRest>
+		struct SizeSum<kFirst, kRest...> : std::integral_constant<uint32_t, kFirst + SizeSum<kRest...>::value> {};
+
+		template<typename Tuple>
+		struct TupleWireSize;
+
+		template<typename... Fields>
+		struct TupleWireSize<std::tuple<Fields...>> : SizeSum<Fields::kSize...> {};
+
+		//char[N]和std::array<char,N>
+		template<typename M>
+		struct CharArrayTraits;
+
+		template<size_t N>
+		struct CharArrayTraits<char[N]>
+		{
+			static const uint32_t kSize = N;
+			static char* Data(char(&a)[N]) { return a; }
+			static const char* Data(const char(&a)[N]) { return a; }
+		};
+
+		template<size_t N>
+		struct CharArrayTraits<std::array<char, N>>
+		{
+			static const uint32_t kSize = N;
+			static char* Data(std::array<char, N>& a) { return a.data(); }
+			static const char* Data(const std::array<char, N>& a) { return a.data(); }
+		};
+
+		inline void PutChars(uint8_t* p, const char* src, size_t len, uint32_t size, StringRule rule)
+		{
+			if (rule == StringRule::kRaw)
+			{
+				memcpy(p, src, len);
+				if (len < size)
+					memset(p + len, 0, size - len);
+				return;
+			}
+
+			const void* end = memchr(src, 0, len);
+			if (end != nullptr)
+				len = static_cast<const char*>(end) - src;
+
+			memcpy(p, src, len);
+			if (len < size)
+				memset(p + len, rule == StringRule::kSpacePadded ? ' ' : 0, size - len);
+		}
+
+		//返回去掉尾部填充后的长度
+		inline uint32_t TrimmedLength(const uint8_t* p, uint32_t size, StringRule rule)
+		{
+			if (rule == StringRule::kRaw)
+				return size;
+
+			while (size != 0 && (p[size - 1] == 0 || (rule == StringRule::kSpacePadded && p[size - 1] == ' ')))
+				--size;
+			return size;
+		}
+	}
+
+	//报文的编码长度
+	template<typename T>
+	struct WireSize : detail::TupleWireSize<typename std::decay<decltype(FieldsOf<T>::Get())>::type> {};
+
+	template<typename T>
+	uint8_t* EncodeTo(uint8_t* p, const T& value);
+
+	template<typename T>
+	const uint8_t* DecodeFrom(const uint8_t* p, T& value);
+
+	template<typename C, typename T, bool kBigEndian>
+	struct IntegerField
+	{
+		static_assert(std::is_integral<T>::value, "must be Integer .");
+		static const uint32_t kSize = sizeof(T);
+
+		uint8_t* Encode(uint8_t* p, const C& c) const
+		{
+			T value = c.*member_;
+			if (kBigEndian)
+				endian::HToBe(value);
+			else
+				endian::HToLe(value);
+			memcpy(p, &value, sizeof(value));
+			return p + kSize;
+		}
+
+		const uint8_t* Decode(const uint8_t* p, C& c) const
+		{
+			T value;
+			memcpy(&value, p, sizeof(value));
+			if (kBigEndian)
+				endian::BeToH(value);
+			else
+				endian::LeToH(value);
+			c.*member_ = value;
+			return p + kSize;
+		}
+
+		T C::* member_;
+	};
+
+	template<typename C, typename M>
+	struct CharArrayField
+	{
+		static const uint32_t kSize = detail::CharArrayTraits<M>::kSize;
+
+		uint8_t* Encode(uint8_t* p, const C& c) const
+		{
+			detail::PutChars(p, detail::CharArrayTraits<M>::Data(c.*member_), kSize, kSize, rule_);
+			return p + kSize;
+		}
+
+		//解码后去掉的填充部分置为'\0'
+		const uint8_t* Decode(const uint8_t* p, C& c) const
+		{
+			char* data = detail::CharArrayTraits<M>::Data(c.*member_);
+			uint32_t len = detail::TrimmedLength(p, kSize, rule_);
+			memcpy(data, p, len);
+			memset(data + len, 0, kSize - len);
+			return p + kSize;
+		}
+
+		M C::* member_;
+		StringRule rule_;
+	};
+
+	template<uint32_t N, typename C>
+	struct StringField
+	{
+		static const uint32_t kSize = N;
+
+		//超出N的部分截断
+		uint8_t* Encode(uint8_t* p, const C& c) const
+		{
+			const std::string& str = c.*member_;
+			detail::PutChars(p, str.data(), str.size() < N ? str.size() : N, N, rule_);
+			return p + kSize;
+		}
+
+		const uint8_t* Decode(const uint8_t* p, C& c) const
+		{
+			(c.*member_).assign(reinterpret_cast<const char*>(p), detail::TrimmedLength(p, N, rule_));
+			return p + kSize;
+		}
+
+		std::string C::* member_;
+		StringRule rule_;
+	};
+
+	template<typename C, typename M>
+	struct NestedField
+	{
+		static const uint32_t kSize = WireSize<M>::value;
+
+		uint8_t* Encode(uint8_t* p, const C& c) const
+		{
+			return EncodeTo(p, c.*member_);
+		}
+
+		const uint8_t* Decode(const uint8_t* p, C& c) const
+		{
+			return DecodeFrom(p, c.*member_);
+		}
+
+		M C::* member_;
+	};
+
+	template<typename C, typename T>
+	constexpr IntegerField<C, T, true> IntegerBE(T C::* member)
+	{
+		return IntegerField<C, T, true>{ member };
+	}
+
+	template<typename C, typename T>
+	constexpr IntegerField<C, T, false> IntegerLE(T C::* member)
+	{
+		return IntegerField<C, T, false>{ member };
+	}
+
+	template<typename C, typename M>
+	constexpr CharArrayField<C, M> CharArray(M C::* member, StringRule rule = StringRule::kSpacePadded)
+	{
+		return CharArrayField<C, M>{ member, rule };
+	}
+
+	template<uint32_t N, typename C>
+	constexpr StringField<N, C> FixedString(std::string C::* member, StringRule rule = StringRule::kSpacePadded)
+	{
+		return StringField<N, C>{ member, rule };
+	}
+
+	template<typename C, typename M>
+	constexpr NestedField<C, M> Nested(M C::* member)
+	{
+		return NestedField<C, M>{ member };
+	}
+
+	namespace detail
+	{
+		//逗号表达式展开,初始化列表保证按字段顺序求值
+		template<typename T, typename Fields, size_t... I>
+		uint8_t* EncodeFields(uint8_t* p, const T& value, const Fields& fields, std::index_sequence<I...>)
+		{
+			int expand[] = { 0, (p = std::get<I>(fields).Encode(p, value), 0)... };
+			(void)expand;
+			return p;
+		}
+
+		template<typename T, typename Fields, size_t... I>
+		const uint8_t* DecodeFields(const uint8_t* p, T& value, const Fields& fields, std::index_sequence<I...>)
+		{
+			int expand[] = { 0, (p = std::get<I>(fields).Decode(p, value), 0)... };
+			(void)expand;
+			return p;
+		}
+	}
+
+	//不检查长度,p至少要有WireSize<T>::value字节,返回写完之后的位置
+	template<typename T>
+	uint8_t* EncodeTo(uint8_t* p, const T& value)
+	{
+		const auto fields = FieldsOf<T>::Get();
+		return detail::EncodeFields(p, value, fields, std::make_index_sequence<std::tuple_size<decltype(fields)>::value>());
+	}
+
+	template<typename T>
+	const uint8_t* DecodeFrom(const uint8_t* p, T& value)
+	{
+		const auto fields = FieldsOf<T>::Get();
+		return detail::DecodeFields(p, value, fields, std::make_index_sequence<std::tuple_size<decltype(fields)>::value>());
+	}
+
+	template<typename T>
+	void Encode(DataBuffer& buffer, const T& value)
+	{
+		const uint32_t size = WireSize<T>::value;
+		buffer.Write(nullptr, size);
+		EncodeTo(buffer.GetWritePtr() - size, value);
+	}
+
+	template<typename T>
+	void Decode(DataBuffer& buffer, T& value)
+	{
+		const uint32_t size = WireSize<T>::value;
+		if (buffer.GetDataSize() < size)
+			throw std::runtime_error("Decode exception:Read data length exceeds buffer size");
+
+		DecodeFrom(buffer.GetReadPtr(), value);
+		buffer.Read(nullptr, size);
+	}
+}
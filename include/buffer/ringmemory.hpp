@@ -0,0 +1,130 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+//双重映射的环形内存:同一段物理内存连续映射两次,[base,base+size)和[base+size,base+2*size)内容相同
+//跨越末尾的读写在虚拟地址上仍然是连续的,环形缓冲区不需要回绕拷贝
+//size必须是Granularity()的整数倍,不支持的平台Allocate返回nullptr
+
+#if defined(_WIN32)
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#	define RINGMEMORY_SUPPORTED
+#elif defined(__linux__)
+#	include <unistd.h>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	define RINGMEMORY_SUPPORTED
+#endif
+
+namespace ringmemory
+{
+	inline size_t Granularity()
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwAllocationGranularity;
+#elif defined(__linux__)
+		static const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+		return page_size;
+#else
+		return 4096;
+#endif
+	}
+
+	inline size_t RoundUp(size_t size)
+	{
+		size_t granularity = Granularity();
+		if (size == 0)
+			size = 1;
+		return (size + granularity - 1) / granularity * granularity;
+	}
+
+	inline uint8_t* Allocate(size_t size)
+	{
+#if defined(_WIN32)
+		HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, nullptr);
+		if (mapping == nullptr)
+			return nullptr;
+
+		//先保留2*size的地址再释放,然后把两个视图映射上去,中间可能被其它线程抢占,失败时重试
+		uint8_t* result = nullptr;
+		for (int retry = 0; retry < 16 && result == nullptr; ++retry)
+		{
+			void* base = VirtualAlloc(nullptr, size * 2, MEM_RESERVE, PAGE_NOACCESS);
+			if (base == nullptr)
+				break;
+			VirtualFree(base, 0, MEM_RELEASE);
+
+			void* first = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, base);
+			if (first == nullptr)
+				continue;
+
+			void* second = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, (uint8_t*)base + size);
+			if (second == nullptr)
+			{
+				UnmapViewOfFile(first);
+				continue;
+			}
+
+			result = (uint8_t*)first;
+		}
+
+		//视图持有映射对象的引用
+		CloseHandle(mapping);
+		return result;
+#elif defined(__linux__)
+		int fd = (int)syscall(SYS_memfd_create, "ringbuffer", 0);
+		if (fd < 0)
+			return nullptr;
+
+		if (ftruncate(fd, (off_t)size) != 0)
+		{
+			close(fd);
+			return nullptr;
+		}
+
+		//先保留2*size的地址,再用MAP_FIXED把同一个fd映射到前后两半
+		void* base = mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+		{
+			close(fd);
+			return nullptr;
+		}
+
+		void* first = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+		void* second = mmap((uint8_t*)base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+		close(fd);
+
+		if (first == MAP_FAILED || second == MAP_FAILED)
+		{
+			munmap(base, size * 2);
+			return nullptr;
+		}
+
+		return (uint8_t*)base;
+#else
+		(void)size;
+		return nullptr;
+#endif
+	}
+
+	inline void Free(uint8_t* base, size_t size)
+	{
+		if (base == nullptr)
+			return;
+
+#if defined(_WIN32)
+		UnmapViewOfFile(base + size);
+		UnmapViewOfFile(base);
+#elif defined(__linux__)
+		munmap(base, size * 2);
+#else
+		(void)size;
+#endif
+	}
+}
@@ -6,6 +6,8 @@
 #include <array>
 #include "boost/array.hpp"
 #include "boost/algorithm/string/trim.hpp"
+#include "boost/utility/string_view.hpp"
+#include "bytescan.hpp"
 
 
 namespace notstd
@@ -208,3 +210,58 @@ SetValue(T1& t1, const T2& t2)
 {
 	t1 = t2;
 }
+
+
+//定长字段去掉尾部空格和'\0'后的视图,不分配内存,视图引用字段本身的内存
+//和trim_right不同,只去掉空格和'\0',不处理其它空白字符,也不依赖locale
+inline boost::string_view TrimRightView(const char* data, std::size_t size)
+{
+	const uint8_t* begin = reinterpret_cast<const uint8_t*>(data);
+	return boost::string_view(data, bytescan::TrimRight(begin, begin + size) - begin);
+}
+
+template<std::size_t N>
+boost::string_view TrimRightView(const char(&t)[N])
+{
+	return TrimRightView(t, N);
+}
+
+template<std::size_t N>
+boost::string_view TrimRightView(const std::array<char, N>& t)
+{
+	return TrimRightView(t.data(), N);
+}
+
+template<std::size_t N>
+boost::string_view TrimRightView(const boost::array<char, N>& t)
+{
+	return TrimRightView(t.data(), N);
+}
+
+//char[]/array<char> -> string_view
+template<typename T>
+auto SetValue(boost::string_view& view, const T& t) -> decltype(TrimRightView(t), void())
+{
+	view = TrimRightView(t);
+}
+
+//批量转换:一条记录的多个定长字段一次转换成视图
+struct FixedField
+{
+	const char* data_;
+	std::size_t size_;
+};
+
+inline void TrimRightFields(const FixedField* fields, std::size_t count, boost::string_view* views)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		views[i] = TrimRightView(fields[i].data_, fields[i].size_);
+	}
+}
+
+template<typename... T>
+std::array<boost::string_view, sizeof...(T)> TrimRightViews(const T&... fields)
+{
+	return std::array<boost::string_view, sizeof...(T)>{ { TrimRightView(fields)... } };
+}
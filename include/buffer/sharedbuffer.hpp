@@ -0,0 +1,192 @@
+#pragma once
+#include<cstdint>
+#include<cstddef>
+#include<string>
+#include<atomic>
+#include<new>
+#include<stdexcept>
+#include<type_traits>
+#include<string.h>
+#include "databuffer.hpp"
+
+//不可变的引用计数缓冲区
+//同一份编码好的数据可以同时排在多个session的发送队列里,拷贝SharedBuffer只增加引用计数,不拷贝数据
+class SharedBuffer
+{
+public:
+	SharedBuffer() :holder_(nullptr), data_(nullptr), size_(0) {}
+
+	//拷贝一次数据,数据和引用计数在同一块内存里
+	SharedBuffer(const void* data, size_t size) :holder_(nullptr), data_(nullptr), size_(0)
+	{
+		if (size == 0)
+			return;
+
+		void* mem = ::operator new(sizeof(RawHolder) + size);
+		RawHolder* holder = new (mem) RawHolder();
+		uint8_t* buf = reinterpret_cast<uint8_t*>(holder + 1);
+		if (data != nullptr)
+			memcpy(buf, data, size);
+
+		holder_ = holder;
+		data_ = buf;
+		size_ = size;
+	}
+
+	//接管std::string,不拷贝数据
+	explicit SharedBuffer(std::string&& data) :holder_(nullptr), data_(nullptr), size_(0)
+	{
+		if (data.empty())
+			return;
+
+		auto holder = new OwnerHolder<std::string>(std::move(data));
+		holder_ = holder;
+		data_ = reinterpret_cast<const uint8_t*>(holder->owner_.data());
+		size_ = holder->owner_.size();
+	}
+
+	//接管DataBuffer,内容为其可读部分[ReadPos,WritePos)
+	//注意:不拷贝数据的DataBuffer(copy_data == false)只转移指针,底层内存的生命周期仍由调用者保证
+	explicit SharedBuffer(DataBuffer&& data) :holder_(nullptr), data_(nullptr), size_(0)
+	{
+		if (data.GetDataSize() == 0)
+			return;
+
+		auto holder = new OwnerHolder<DataBuffer>(std::move(data));
+		holder_ = holder;
+		data_ = holder->owner_.GetReadPtr();
+		size_ = holder->owner_.GetDataSize();
+	}
+
+	//和owner共享引用计数,但指向[data,data+size),这段内存必须由owner持有的对象保证有效
+	SharedBuffer(const SharedBuffer& owner, const void* data, size_t size) :holder_(owner.holder_), data_(static_cast<const uint8_t*>(data)), size_(size)
+	{
+		AddRef();
+	}
+
+	//接管任意对象,返回的SharedBuffer内容为空,只用来配合上面的构造函数共享对象里的多段内存
+	template<typename T>
+	static SharedBuffer Hold(T&& owner)
+	{
+		static_assert(!std::is_lvalue_reference<T>::value, "Hold takes ownership, pass an rvalue");
+
+		SharedBuffer buffer;
+		buffer.holder_ = new OwnerHolder<typename std::decay<T>::type>(std::move(owner));
+		return buffer;
+	}
+
+	SharedBuffer(const SharedBuffer& rhs) :holder_(rhs.holder_), data_(rhs.data_), size_(rhs.size_)
+	{
+		AddRef();
+	}
+
+	SharedBuffer(SharedBuffer&& rhs) :holder_(rhs.holder_), data_(rhs.data_), size_(rhs.size_)
+	{
+		rhs.holder_ = nullptr;
+		rhs.data_ = nullptr;
+		rhs.size_ = 0;
+	}
+
+	SharedBuffer& operator=(const SharedBuffer& rhs)
+	{
+		if (&rhs != this)
+		{
+			SharedBuffer(rhs).Swap(*this);
+		}
+		return *this;
+	}
+
+	SharedBuffer& operator=(SharedBuffer&& rhs)
+	{
+		if (&rhs != this)
+		{
+			SharedBuffer(std::move(rhs)).Swap(*this);
+		}
+		return *this;
+	}
+
+	~SharedBuffer()
+	{
+		Release();
+	}
+
+public:
+	const uint8_t* GetData() const { return data_; }
+	size_t GetSize() const { return size_; }
+	bool Empty() const { return size_ == 0; }
+
+	uint32_t GetUseCount() const
+	{
+		return holder_ != nullptr ? holder_->refs_.load(std::memory_order_relaxed) : 0;
+	}
+
+	//共享同一块内存的子区间
+	SharedBuffer Slice(size_t offset, size_t len) const
+	{
+		if (offset > size_ || len > size_ - offset)
+			throw std::runtime_error("Slice exception:Invalid range");
+
+		SharedBuffer slice(*this);
+		slice.data_ += offset;
+		slice.size_ = len;
+		return slice;
+	}
+
+	void Swap(SharedBuffer& rhs)
+	{
+		std::swap(holder_, rhs.holder_);
+		std::swap(data_, rhs.data_);
+		std::swap(size_, rhs.size_);
+	}
+
+private:
+	struct Holder
+	{
+		Holder() :refs_(1) {}
+		virtual void Destroy() = 0;
+
+		std::atomic<uint32_t> refs_;
+	protected:
+		~Holder() {}
+	};
+
+	struct RawHolder final :Holder
+	{
+		virtual void Destroy()
+		{
+			this->~RawHolder();
+			::operator delete(this);
+		}
+	};
+
+	template<typename T>
+	struct OwnerHolder final :Holder
+	{
+		explicit OwnerHolder(T&& owner) :owner_(std::move(owner)) {}
+		virtual void Destroy()
+		{
+			delete this;
+		}
+
+		T owner_;
+	};
+
+	void AddRef()
+	{
+		if (holder_ != nullptr)
+			holder_->refs_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Release()
+	{
+		if (holder_ != nullptr && holder_->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			holder_->Destroy();
+		}
+		holder_ = nullptr;
+	}
+
+	Holder* holder_;
+	const uint8_t* data_;
+	size_t size_;
+};
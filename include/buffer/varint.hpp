@@ -0,0 +1,238 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <string.h>
+#include "endianconversion.hpp"
+
+//LEB128变长整数和zigzag编码,格式和protobuf相同
+//每字节低7位是数据,最高位为1表示后面还有字节,uint64_t最多10字节
+//解码时剩余数据不少于8字节就一次取8字节,用BMI2的pext(没有BMI2时用移位合并)去掉标志位,不逐字节判断
+
+#if defined(__BMI2__)
+#	define VARINT_BMI2
+#	include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
+
+namespace varint
+{
+	const uint32_t kMaxVarintSize = 10;
+
+	template<typename T>
+	struct MaxSize : std::integral_constant<uint32_t, (sizeof(T) * 8 + 6) / 7> {};
+
+	inline uint32_t CountLeadingZeros64(uint64_t value)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return 63 - (uint32_t)index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanReverse(&index, (uint32_t)(value >> 32)))
+			return 31 - (uint32_t)index;
+		_BitScanReverse(&index, (uint32_t)value);
+		return 63 - (uint32_t)index;
+#else
+		return (uint32_t)__builtin_clzll(value);
+#endif
+	}
+
+	inline uint32_t CountTrailingZeros64(uint64_t value)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return (uint32_t)index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanForward(&index, (uint32_t)value))
+			return (uint32_t)index;
+		_BitScanForward(&index, (uint32_t)(value >> 32));
+		return 32 + (uint32_t)index;
+#else
+		return (uint32_t)__builtin_ctzll(value);
+#endif
+	}
+
+	inline uint64_t ZigZagEncode(int64_t value)
+	{
+		return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	}
+
+	inline int64_t ZigZagDecode(uint64_t value)
+	{
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+
+	//编码后的字节数,不需要循环
+	inline uint32_t Size(uint64_t value)
+	{
+		uint32_t bits = 64 - CountLeadingZeros64(value | 1);
+		return (bits * 9 + 64) / 64;
+	}
+
+	//p至少要有Size(value)字节,返回写入的字节数
+	inline uint32_t Encode(uint8_t* p, uint64_t value)
+	{
+		if (value < 0x80)
+		{
+			p[0] = (uint8_t)value;
+			return 1;
+		}
+
+		uint32_t size = Size(value);
+		uint32_t last = size - 1;
+		for (uint32_t i = 0; i < last; ++i)
+		{
+			p[i] = (uint8_t)(value | 0x80);
+			value >>= 7;
+		}
+		p[last] = (uint8_t)value;
+
+		return size;
+	}
+
+	//p至少要有kMaxVarintSize字节,不超过8字节的编码一次写入8字节,不逐字节循环
+	inline uint32_t EncodeFast(uint8_t* p, uint64_t value)
+	{
+		if (value < 0x80)
+		{
+			p[0] = (uint8_t)value;
+			return 1;
+		}
+
+#if defined SYSTEM_LITTLE_ENDIAN
+		uint32_t size = Size(value);
+		if (size <= 8)
+		{
+#if defined(VARINT_BMI2)
+			uint64_t word = _pdep_u64(value, 0x7F7F7F7F7F7F7F7Full);
+#else
+			uint64_t word = value;
+			word = (word & 0x000000000FFFFFFFull) | ((word & 0x00FFFFFFF0000000ull) << 4);
+			word = (word & 0x00003FFF00003FFFull) | ((word & 0x0FFFC0000FFFC000ull) << 2);
+			word = (word & 0x007F007F007F007Full) | ((word & 0x3F803F803F803F80ull) << 1);
+#endif
+			//除最后一个字节外都置上后续标志
+			word |= 0x8080808080808080ull & ((1ull << (8 * (size - 1))) - 1);
+			memcpy(p, &word, sizeof(word));
+			return size;
+		}
+#endif
+
+		return Encode(p, value);
+	}
+
+	//逐字节解码,返回读取的字节数,数据不完整或超过10字节时返回0
+	inline uint32_t DecodeSlow(const uint8_t* p, size_t size, uint64_t& value)
+	{
+		uint64_t result = 0;
+		size_t limit = size < kMaxVarintSize ? size : kMaxVarintSize;
+		for (size_t i = 0; i < limit; ++i)
+		{
+			uint8_t byte = p[i];
+			result |= (uint64_t)(byte & 0x7F) << (7 * i);
+			if (byte < 0x80)
+			{
+				//第10字节只能有1位有效数据
+				if (i == kMaxVarintSize - 1 && byte > 1)
+					return 0;
+
+				value = result;
+				return (uint32_t)(i + 1);
+			}
+		}
+
+		return 0;
+	}
+
+	inline uint32_t Decode(const uint8_t* p, size_t size, uint64_t& value)
+	{
+#if defined SYSTEM_LITTLE_ENDIAN
+		if (size >= 8)
+		{
+			uint64_t word;
+			memcpy(&word, p, sizeof(word));
+
+			//每字节最高位为0的位置就是结束字节
+			uint64_t stop = ~word & 0x8080808080808080ull;
+			if (stop != 0)
+			{
+				//保留结束字节及之前的字节
+				word &= stop ^ (stop - 1);
+#if defined(VARINT_BMI2)
+				value = _pext_u64(word, 0x7F7F7F7F7F7F7F7Full);
+#else
+				word &= 0x7F7F7F7F7F7F7F7Full;
+				word = ((word & 0x7F007F007F007F00ull) >> 1) | (word & 0x007F007F007F007Full);
+				word = ((word & 0x3FFF00003FFF0000ull) >> 2) | (word & 0x00003FFF00003FFFull);
+				word = ((word & 0x0FFFFFFF00000000ull) >> 4) | (word & 0x000000000FFFFFFFull);
+				value = word;
+#endif
+				return CountTrailingZeros64(stop) / 8 + 1;
+			}
+		}
+#endif
+
+		return DecodeSlow(p, size, value);
+	}
+
+	template<typename T>
+	uint64_t ToWire(T value, std::true_type /*is_signed*/) { return ZigZagEncode((int64_t)value); }
+
+	template<typename T>
+	uint64_t ToWire(T value, std::false_type) { return (uint64_t)value; }
+
+	//有符号类型先zigzag编码,解码时检查取值范围,超出T的范围返回false
+	template<typename T>
+	bool FromWire(uint64_t wire, T& value, std::true_type /*is_signed*/)
+	{
+		int64_t v = ZigZagDecode(wire);
+		if (v < (int64_t)(std::numeric_limits<T>::min)() || v > (int64_t)(std::numeric_limits<T>::max)())
+			return false;
+		value = (T)v;
+		return true;
+	}
+
+	template<typename T>
+	bool FromWire(uint64_t wire, T& value, std::false_type)
+	{
+		if (wire > (uint64_t)(std::numeric_limits<T>::max)())
+			return false;
+		value = (T)wire;
+		return true;
+	}
+
+	//有符号类型的元素按zigzag编码
+	//p至少要有count*MaxSize<T>::value+kMaxVarintSize字节,返回写完之后的位置
+	template<typename T>
+	uint8_t* EncodeArray(uint8_t* p, const T* values, size_t count)
+	{
+		static_assert(std::is_integral<T>::value, "must be Integer .");
+		for (size_t i = 0; i < count; ++i)
+			p += EncodeFast(p, ToWire(values[i], std::is_signed<T>()));
+		return p;
+	}
+
+	//返回读完之后的位置,数据不完整或取值超出范围时返回nullptr,此时values内容不确定
+	template<typename T>
+	const uint8_t* DecodeArray(const uint8_t* p, const uint8_t* end, T* values, size_t count)
+	{
+		static_assert(std::is_integral<T>::value, "must be Integer .");
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint64_t wire;
+			uint32_t n = Decode(p, end - p, wire);
+			if (n == 0 || !FromWire(wire, values[i], std::is_signed<T>()))
+				return nullptr;
+			p += n;
+		}
+		return p;
+	}
+}
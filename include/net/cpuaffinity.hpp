@@ -0,0 +1,203 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+
+#if defined(_WIN32)
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#elif defined(__linux__)
+#	include <pthread.h>
+#	include <sched.h>
+#	include <dirent.h>
+#endif
+
+//线程的CPU亲和性和CPU拓扑(物理核、NUMA节点)
+//Linux读/sys/devices/system/cpu,Windows用GetLogicalProcessorInformation(只支持前64个逻辑CPU),其它平台不支持绑定
+namespace cpuaffinity
+{
+	struct CpuInfo
+	{
+		uint32_t cpu_;		//逻辑CPU编号
+		uint32_t core_;		//物理核,同一个物理核上的超线程相同
+		uint32_t node_;		//NUMA节点
+	};
+
+	namespace detail
+	{
+#if defined(__linux__)
+		inline bool ReadUint(const char* path, uint32_t& value)
+		{
+			FILE* file = fopen(path, "r");
+			if (file == nullptr)
+				return false;
+
+			unsigned int v = 0;
+			bool ok = fscanf(file, "%u", &v) == 1;
+			fclose(file);
+			value = v;
+			return ok;
+		}
+
+		//cpuN目录下的nodeM链接表示所属节点,没有NUMA时为0
+		inline uint32_t ReadNode(uint32_t cpu)
+		{
+			char path[128];
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+			DIR* dir = opendir(path);
+			if (dir == nullptr)
+				return 0;
+
+			uint32_t node = 0;
+			while (dirent* entry = readdir(dir))
+			{
+				unsigned int n;
+				if (sscanf(entry->d_name, "node%u", &n) == 1)
+				{
+					node = n;
+					break;
+				}
+			}
+			closedir(dir);
+			return node;
+		}
+#endif
+	}
+
+	//当前进程可以使用的逻辑CPU,按编号排序
+	inline std::vector<CpuInfo> GetTopology()
+	{
+		std::vector<CpuInfo> cpus;
+
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) != 0)
+			return cpus;
+
+		for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (!CPU_ISSET(cpu, &set))
+				continue;
+
+			char path[128];
+			uint32_t core = cpu, package = 0;
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/core_id", cpu);
+			detail::ReadUint(path, core);
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu);
+			detail::ReadUint(path, package);
+
+			//core_id只在同一个物理CPU内唯一
+			cpus.push_back(CpuInfo{ cpu, (package << 16) | core, detail::ReadNode(cpu) });
+		}
+#elif defined(_WIN32)
+		DWORD length = 0;
+		GetLogicalProcessorInformation(nullptr, &length);
+		std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		if (infos.empty() || !GetLogicalProcessorInformation(infos.data(), &length))
+			return cpus;
+
+		DWORD_PTR process_mask = 0, system_mask = 0;
+		GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+
+		uint32_t core_index = 0;
+		std::map<uint32_t, CpuInfo> by_cpu;
+		for (auto& info : infos)
+		{
+			for (uint32_t cpu = 0; cpu < sizeof(ULONG_PTR) * 8; ++cpu)
+			{
+				if ((info.ProcessorMask & ((ULONG_PTR)1 << cpu)) == 0 || (process_mask & ((DWORD_PTR)1 << cpu)) == 0)
+					continue;
+
+				auto& cpu_info = by_cpu.emplace(cpu, CpuInfo{ cpu, cpu, 0 }).first->second;
+				if (info.Relationship == RelationProcessorCore)
+					cpu_info.core_ = core_index;
+				else if (info.Relationship == RelationNumaNode)
+					cpu_info.node_ = info.NumaNode.NodeNumber;
+			}
+
+			if (info.Relationship == RelationProcessorCore)
+				++core_index;
+		}
+
+		for (auto& cpu : by_cpu)
+			cpus.push_back(cpu.second);
+#endif
+
+		return cpus;
+	}
+
+	//把当前线程绑定到cpus中的任意一个上,cpus为空或平台不支持时返回false
+	inline bool PinCurrentThread(const std::vector<uint32_t>& cpus)
+	{
+		if (cpus.empty())
+			return false;
+
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (auto cpu : cpus)
+		{
+			if (cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &set);
+		}
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+		DWORD_PTR mask = 0;
+		for (auto cpu : cpus)
+		{
+			if (cpu < sizeof(DWORD_PTR) * 8)
+				mask |= (DWORD_PTR)1 << cpu;
+		}
+		return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+		return false;
+#endif
+	}
+
+	//给workers个线程各分配一个逻辑CPU:按NUMA节点轮流分配,节点内先用不同的物理核,物理核用完了再用超线程,CPU不够时从头复用
+	//拓扑不可用时返回空
+	inline std::vector<std::vector<uint32_t>> AutoAssign(size_t workers)
+	{
+		std::vector<std::vector<uint32_t>> cpu_sets;
+		std::vector<CpuInfo> cpus = GetTopology();
+		if (cpus.empty() || workers == 0)
+			return cpu_sets;
+
+		//每个节点内的顺序:每个物理核的第一个逻辑CPU,然后是第二个...
+		std::map<uint32_t, std::vector<CpuInfo>> nodes;
+		for (auto& cpu : cpus)
+			nodes[cpu.node_].push_back(cpu);
+
+		std::vector<std::vector<uint32_t>> node_order;
+		for (auto& node : nodes)
+		{
+			std::map<uint32_t, uint32_t> sibling_index;
+			std::vector<std::pair<uint32_t, uint32_t>> ranked;	//(核内序号,CPU)
+			for (auto& cpu : node.second)
+				ranked.emplace_back(sibling_index[cpu.core_]++, cpu.cpu_);
+			std::stable_sort(ranked.begin(), ranked.end(),
+				[](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) { return a.first < b.first; });
+
+			std::vector<uint32_t> order;
+			for (auto& r : ranked)
+				order.push_back(r.second);
+			node_order.push_back(std::move(order));
+		}
+
+		std::vector<size_t> next(node_order.size(), 0);
+		for (size_t i = 0; i < workers; ++i)
+		{
+			size_t node = i % node_order.size();
+			auto& order = node_order[node];
+			cpu_sets.push_back(std::vector<uint32_t>{ order[next[node]++ % order.size()] });
+		}
+
+		return cpu_sets;
+	}
+}
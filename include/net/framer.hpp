@@ -0,0 +1,329 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include "buffer/databuffer.hpp"
+#include "buffer/bufferview.hpp"
+#include "buffer/endianconversion.hpp"
+#include "buffer/bytescan.hpp"
+#include "sessionerror.hpp"
+
+//分包策略,作为TcpSession的模板参数,在读循环里内联展开
+//
+//每个Framer提供:
+//  template <typename Session> bool Decode(Session& session, DataBuffer& buffer);
+//      每次读完成后调用,从buffer里取出完整的包交给session,返回false表示停止读(暂停或已关闭)
+//  kNeedRecvCallback/kNeedMessageCallback/kNeedBodyLengthCallback
+//      Decode会调用哪些回调;kNeedBodyLengthCallback时session在SetFrameHandler时取一次OnGetHeaderLength
+//
+//Framer对象保存配置和跨读操作的解析状态,每个session一份,由TcpServer/TcpClient从原型拷贝
+
+//原始字节流,整个接收缓冲区交给OnRecv,由应用自己分包
+class RawFramer
+{
+public:
+	static const bool kNeedRecvCallback = true;
+	static const bool kNeedMessageCallback = false;
+	static const bool kNeedBodyLengthCallback = false;
+
+	template <typename Session>
+	bool Decode(Session& session, DataBuffer& buffer)
+	{
+		return session.DeliverRecv(buffer);
+	}
+};
+
+//固定长度包头,包体长度由应用的OnGetBodyLength根据包头计算
+//包体长度来自对端,包长超过max_frame_size时在扩容接收缓冲区之前就关闭连接
+class HeaderBodyFramer
+{
+public:
+	static const bool kNeedRecvCallback = false;
+	static const bool kNeedMessageCallback = true;
+	static const bool kNeedBodyLengthCallback = true;
+
+	static const uint32_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+
+	HeaderBodyFramer() :max_frame_size_(kDefaultMaxFrameSize), pending_body_size_(-1) {}
+
+	//包头加包体的最大长度,超过时以SessionError::kFrameTooLarge关闭连接
+	void SetMaxFrameSize(uint32_t max_frame_size) { max_frame_size_ = max_frame_size; }
+	uint32_t GetMaxFrameSize() const { return max_frame_size_; }
+
+	template <typename Session>
+	bool Decode(Session& session, DataBuffer& buffer)
+	{
+		uint32_t header_size = session.GetFrameHeaderSize();
+
+		while (session.IsConnect())
+		{
+			uint32_t data_size = buffer.GetDataSize();
+			if (data_size < header_size)
+				break;
+
+			const uint8_t* frame = buffer.GetReadPtr();
+
+			//包体未收全时保留已算出的长度,每个包只调用一次OnGetBodyLength
+			if (pending_body_size_ < 0)
+			{
+				pending_body_size_ = session.GetFrameBodyLength(BufferView(frame, header_size));
+				if (pending_body_size_ < 0)
+				{
+					session.CloseOnFrameError(SessionError::kInvalidFrame);
+					return false;
+				}
+
+				if ((uint64_t)header_size + (uint32_t)pending_body_size_ > max_frame_size_)
+				{
+					pending_body_size_ = -1;
+					session.CloseOnFrameError(SessionError::kFrameTooLarge);
+					return false;
+				}
+			}
+
+			uint32_t frame_size = header_size + (uint32_t)pending_body_size_;
+			if (data_size < frame_size)
+			{
+				session.ReserveRecvBuffer(frame_size);
+				break;
+			}
+
+			pending_body_size_ = -1;
+			buffer.Read(nullptr, frame_size);
+
+			session.DeliverMessage(BufferView(frame, header_size), BufferView(frame + header_size, frame_size - header_size));
+		}
+
+		return session.IsConnect();
+	}
+
+private:
+	uint32_t max_frame_size_;
+	int32_t pending_body_size_;
+};
+
+//通用长度字段分包:包头里offset处有一个width字节的长度字段
+//  包长 = offset + width + 长度字段的值 + length_adjustment
+//  长度字段的值包含整个包时,length_adjustment = -(offset + width)
+//  包头为包的前header_size个字节(默认到长度字段结束),其余为包体
+//长度字段直接按endian::BeToH/LeToH解码,不经过虚函数和std::function;
+//包长超过max_frame_size时在扩容接收缓冲区之前就关闭连接
+class LengthFieldFramer
+{
+public:
+	static const bool kNeedRecvCallback = false;
+	static const bool kNeedMessageCallback = true;
+	static const bool kNeedBodyLengthCallback = false;
+
+	static const uint32_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+
+	LengthFieldFramer() :length_field_offset_(0), length_field_width_(4), big_endian_(true), length_adjustment_(0), header_size_(4), max_frame_size_(kDefaultMaxFrameSize) {}
+
+	//width只能是1,2,4,8
+	void SetLengthField(uint32_t offset, uint32_t width, bool big_endian = true)
+	{
+		if (width != 1 && width != 2 && width != 4 && width != 8)
+			throw std::invalid_argument("SetLengthField exception:width must be 1,2,4 or 8");
+
+		length_field_offset_ = offset;
+		length_field_width_ = width;
+		big_endian_ = big_endian;
+		header_size_ = offset + width;
+	}
+
+	void SetLengthAdjustment(int32_t length_adjustment) { length_adjustment_ = length_adjustment; }
+
+	//长度字段的值是否包含长度字段及其之前的字节
+	void SetLengthIncludesHeader(bool include)
+	{
+		length_adjustment_ = include ? -(int32_t)(length_field_offset_ + length_field_width_) : 0;
+	}
+
+	//长度字段之后还有其它包头字段时,把它们也算进交给OnMessage的header
+	void SetHeaderSize(uint32_t header_size)
+	{
+		if (header_size < length_field_offset_ + length_field_width_)
+			throw std::invalid_argument("SetHeaderSize exception:header must contain the length field");
+
+		header_size_ = header_size;
+	}
+
+	void SetMaxFrameSize(uint32_t max_frame_size) { max_frame_size_ = max_frame_size; }
+	uint32_t GetMaxFrameSize() const { return max_frame_size_; }
+
+	template <typename Session>
+	bool Decode(Session& session, DataBuffer& buffer)
+	{
+		while (session.IsConnect())
+		{
+			uint32_t data_size = buffer.GetDataSize();
+			if (data_size < header_size_)
+				break;
+
+			const uint8_t* frame = buffer.GetReadPtr();
+
+			int64_t frame_size = (int64_t)length_field_offset_ + length_field_width_ + length_adjustment_ + (int64_t)ReadLengthField(frame + length_field_offset_);
+			if (frame_size > (int64_t)max_frame_size_)
+			{
+				session.CloseOnFrameError(SessionError::kFrameTooLarge);
+				return false;
+			}
+
+			if (frame_size < (int64_t)header_size_)
+			{
+				session.CloseOnFrameError(SessionError::kInvalidFrame);
+				return false;
+			}
+
+			if (data_size < (uint64_t)frame_size)
+			{
+				session.ReserveRecvBuffer((uint32_t)frame_size);
+				break;
+			}
+
+			buffer.Read(nullptr, (uint32_t)frame_size);
+
+			session.DeliverMessage(BufferView(frame, header_size_), BufferView(frame + header_size_, (uint32_t)frame_size - header_size_));
+		}
+
+		return session.IsConnect();
+	}
+
+private:
+	//超过int64_t范围的8字节长度按最大值处理,必然超过max_frame_size
+	uint64_t ReadLengthField(const uint8_t* field) const
+	{
+		switch (length_field_width_)
+		{
+		case 1:
+			return *field;
+		case 2:
+			return ReadInteger<uint16_t>(field);
+		case 4:
+			return ReadInteger<uint32_t>(field);
+		default:
+			return std::min<uint64_t>(ReadInteger<uint64_t>(field), INT32_MAX + (uint64_t)max_frame_size_);
+		}
+	}
+
+	template <typename T>
+	T ReadInteger(const uint8_t* field) const
+	{
+		T value;
+		memcpy(&value, field, sizeof(value));
+		if (big_endian_)
+			endian::BeToH(value);
+		else
+			endian::LeToH(value);
+		return value;
+	}
+
+	uint32_t length_field_offset_;
+	uint32_t length_field_width_;
+	bool big_endian_;
+	int32_t length_adjustment_;
+	uint32_t header_size_;
+	uint32_t max_frame_size_;
+};
+
+//4字节大端长度前缀(不含前缀本身)
+class LengthPrefixedFramer : public LengthFieldFramer
+{
+public:
+	LengthPrefixedFramer()
+	{
+		SetLengthField(0, sizeof(uint32_t), true);
+	}
+};
+
+//分隔符分包(按行/按记录的文本协议),支持单字节和多字节分隔符
+//记录交给OnMessage时header为空,body为不含分隔符的记录内容
+//用SSE2/AVX2查找分隔符,并记住已扫描过的位置,数据分多次到达时不会重复扫描
+class DelimiterFramer
+{
+public:
+	static const bool kNeedRecvCallback = false;
+	static const bool kNeedMessageCallback = true;
+	static const bool kNeedBodyLengthCallback = false;
+
+	static const uint32_t kDefaultMaxRecordSize = 64 * 1024;
+
+	DelimiterFramer() :delimiter_("\n"), max_record_size_(kDefaultMaxRecordSize), scan_offset_(0) {}
+
+	void SetDelimiter(std::string delimiter)
+	{
+		if (delimiter.empty())
+			throw std::invalid_argument("SetDelimiter exception:delimiter must not be empty");
+
+		delimiter_ = std::move(delimiter);
+		scan_offset_ = 0;
+	}
+
+	//不含分隔符的最大记录长度,超过时以SessionError::kFrameTooLarge关闭连接
+	void SetMaxRecordSize(uint32_t max_record_size) { max_record_size_ = max_record_size; }
+	uint32_t GetMaxRecordSize() const { return max_record_size_; }
+
+	template <typename Session>
+	bool Decode(Session& session, DataBuffer& buffer)
+	{
+		const uint8_t* delimiter = reinterpret_cast<const uint8_t*>(delimiter_.data());
+		const uint32_t delimiter_size = (uint32_t)delimiter_.size();
+
+		while (session.IsConnect())
+		{
+			const uint8_t* data = buffer.GetReadPtr();
+			uint32_t data_size = buffer.GetDataSize();
+
+			//scan_offset_之前的位置上一次已经确认不是分隔符的起点
+			const uint8_t* found = nullptr;
+			if (data_size >= scan_offset_ + delimiter_size)
+			{
+				if (delimiter_size == 1)
+					found = bytescan::FindByte(data + scan_offset_, data + data_size, delimiter[0]);
+				else
+					found = bytescan::FindBytes(data + scan_offset_, data + data_size, delimiter, delimiter_size);
+			}
+
+			if (found == nullptr)
+			{
+				if (data_size >= delimiter_size)
+					scan_offset_ = data_size - delimiter_size + 1;
+
+				if (scan_offset_ > max_record_size_)
+				{
+					session.CloseOnFrameError(SessionError::kFrameTooLarge);
+					return false;
+				}
+
+				//缓冲区已满还没有找到分隔符,扩容后继续读
+				if (data_size >= buffer.GetCapacitySize())
+				{
+					uint64_t wanted = std::max<uint64_t>((uint64_t)buffer.GetCapacitySize() * 2, 1);
+					session.ReserveRecvBuffer((uint32_t)std::min<uint64_t>(wanted, (uint64_t)max_record_size_ + delimiter_size));
+				}
+				break;
+			}
+
+			uint32_t record_size = (uint32_t)(found - data);
+			if (record_size > max_record_size_)
+			{
+				session.CloseOnFrameError(SessionError::kFrameTooLarge);
+				return false;
+			}
+
+			scan_offset_ = 0;
+			buffer.Read(nullptr, record_size + delimiter_size);
+
+			session.DeliverMessage(BufferView(), BufferView(data, record_size));
+		}
+
+		return session.IsConnect();
+	}
+
+private:
+	std::string delimiter_;
+	uint32_t max_record_size_;
+	uint32_t scan_offset_;		//相对于读位置,之前的字节已扫描过
+};
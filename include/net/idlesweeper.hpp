@@ -0,0 +1,175 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include "boost/noncopyable.hpp"
+#include "boost/asio.hpp"
+#include "timingwheel.hpp"
+
+//接收超时的检测方式
+enum class IdlePolicy :uint8_t
+{
+	kTimer = 0,		//每次读时在时间轮上顺延接收超时(TimingWheel::Rearm)
+	kSweep			//每次读完成只记录粗粒度时间戳,由所属io线程的IdleSweeper定期扫描,关闭超时的session
+};
+
+//空闲扫描,每个io_service一份(boost::asio::use_service<IdleSweeper>(ios)),只能在该io_service的线程里使用
+//  登记的Entry每kSweepMilliseconds检查一次最后活动时间,超过timeout时调用handler并自动移除
+//  数据路径上只有调用者自己记录时间戳(TimingWheel::GetCoarseMilliseconds),没有任何定时器操作
+//  扫描本身挂在时间轮上,没有Entry时停止;超时的精度为kSweepMilliseconds
+//  Entry登记期间持有owner的引用,超时或Remove后释放
+class IdleSweeper : public boost::asio::io_service::service, public IoServiceId<IdleSweeper>
+{
+public:
+	static const uint32_t kSweepMilliseconds = 1000;
+
+	class Entry : boost::noncopyable
+	{
+	public:
+		Entry() :prev_(nullptr), next_(nullptr), last_active_(nullptr), timeout_milliseconds_(0) {}
+
+		//超时时在io线程里调用
+		void SetHandler(std::function<void()> handler) { handler_ = std::move(handler); }
+
+		bool IsLinked() const { return next_ != nullptr; }
+
+	private:
+		friend class IdleSweeper;
+
+		Entry* prev_;
+		Entry* next_;
+		const uint64_t* last_active_;
+		uint64_t timeout_milliseconds_;
+		std::shared_ptr<void> owner_;
+		std::function<void()> handler_;
+	};
+
+	explicit IdleSweeper(boost::asio::io_service& ios)
+		:boost::asio::io_service::service(ios), timing_wheel_(boost::asio::use_service<TimingWheel>(ios)), count_(0)
+	{
+		InitList(entries_);
+		sweep_entry_.SetHandler(std::bind(&IdleSweeper::Sweep, this));
+	}
+
+	~IdleSweeper()
+	{
+		ReleaseAll();
+	}
+
+	//last_active由调用者在每次活动时用TimingWheel::GetCoarseMilliseconds更新,登记时置为当前时间
+	//已经登记时只修改timeout
+	template<typename Rep, typename Period>
+	void Add(Entry& entry, uint64_t* last_active, std::chrono::duration<Rep, Period> timeout, std::shared_ptr<void> owner)
+	{
+		entry.timeout_milliseconds_ = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+		if (entry.IsLinked())
+			return;
+
+		if (!sweep_entry_.IsArmed())
+			timing_wheel_.Arm(sweep_entry_, std::chrono::milliseconds(kSweepMilliseconds), nullptr);
+
+		*last_active = timing_wheel_.GetCoarseMilliseconds();
+		entry.last_active_ = last_active;
+		entry.owner_ = std::move(owner);
+		PushBack(entries_, entry);
+		++count_;
+	}
+
+	void Remove(Entry& entry)
+	{
+		if (!entry.IsLinked())
+			return;
+
+		Unlink(entry);
+		--count_;
+		entry.owner_.reset();
+	}
+
+	size_t GetCount() const { return count_; }
+
+private:
+	void shutdown() override
+	{
+		ReleaseAll();
+	}
+
+	static void InitList(Entry& head)
+	{
+		head.prev_ = &head;
+		head.next_ = &head;
+	}
+
+	static void Unlink(Entry& entry)
+	{
+		entry.prev_->next_ = entry.next_;
+		entry.next_->prev_ = entry.prev_;
+		entry.prev_ = nullptr;
+		entry.next_ = nullptr;
+	}
+
+	static void PushBack(Entry& head, Entry& entry)
+	{
+		entry.prev_ = head.prev_;
+		entry.next_ = &head;
+		head.prev_->next_ = &entry;
+		head.prev_ = &entry;
+	}
+
+	void Sweep()
+	{
+		uint64_t now = timing_wheel_.GetCoarseMilliseconds();
+
+		//整个链表先移到pending,handler里可以Remove任意Entry(通常是关闭别的session)
+		Entry pending;
+		InitList(pending);
+		if (entries_.next_ != &entries_)
+		{
+			pending.next_ = entries_.next_;
+			pending.prev_ = entries_.prev_;
+			pending.next_->prev_ = &pending;
+			pending.prev_->next_ = &pending;
+			InitList(entries_);
+		}
+
+		while (pending.next_ != &pending)
+		{
+			Entry& entry = *pending.next_;
+			Unlink(entry);
+
+			if (now < *entry.last_active_ + entry.timeout_milliseconds_)
+			{
+				PushBack(entries_, entry);
+				continue;
+			}
+
+			--count_;
+			std::shared_ptr<void> owner(std::move(entry.owner_));
+			if (entry.handler_)
+				entry.handler_();
+		}
+
+		if (count_ != 0 && !sweep_entry_.IsArmed())
+			timing_wheel_.Arm(sweep_entry_, std::chrono::milliseconds(kSweepMilliseconds), nullptr);
+	}
+
+	void ReleaseAll()
+	{
+		std::vector<std::shared_ptr<void>> owners;
+		while (entries_.next_ != nullptr && entries_.next_ != &entries_)
+		{
+			Entry& entry = *entries_.next_;
+			Unlink(entry);
+			owners.push_back(std::move(entry.owner_));
+		}
+		count_ = 0;
+
+		timing_wheel_.Cancel(sweep_entry_);
+	}
+
+	TimingWheel& timing_wheel_;
+	TimingWheel::Entry sweep_entry_;
+	Entry entries_;		//带头结点的环形链表
+	size_t count_;
+};
@@ -4,10 +4,14 @@
 #include <exception>
 #include <list>
 #include <algorithm>
+#include <vector>
+#include <functional>
+#include <stdio.h>
 #include "boost/noncopyable.hpp"
 #include "boost/asio.hpp"
 #include "boost/thread.hpp"
 #include "boost/system/error_code.hpp"
+#include "cpuaffinity.hpp"
 
 class IoServicePool : boost::noncopyable
 {
@@ -22,8 +26,11 @@ public:
 			, work_(std::make_unique<boost::asio::io_service::work>(ios_))
 		{}
 
-		void Start()
+		//cpus为空表示不绑定,initializer在工作线程里run之前调用
+		void Start(std::vector<uint32_t> cpus, std::function<void(boost::asio::io_service&)> initializer)
 		{
+			cpus_ = std::move(cpus);
+			initializer_ = std::move(initializer);
 			worker_ = boost::thread(std::bind(&IosWorker::Run, this));
 		}
 
@@ -50,6 +57,15 @@ public:
 	private:
 		void Run()
 		{
+			//先绑定CPU再初始化,线程里第一次写入的内存(线程局部的池、initializer创建的服务)由所在NUMA节点分配
+			if (!cpus_.empty() && !cpuaffinity::PinCurrentThread(cpus_))
+			{
+				printf("FILE:%s,FUNCTION:%s,LINE:%d,pin to cpu %u failed\n", __FILE__, __FUNCTION__, __LINE__, cpus_.front());
+			}
+
+			if (initializer_)
+				initializer_(ios_);
+
 			boost::system::error_code ec;
 			ios_.run(ec);
 		};
@@ -57,6 +73,8 @@ public:
 		boost::asio::io_service ios_;
 		boost::thread  worker_;
 		ios_work_ptr	work_;
+		std::vector<uint32_t> cpus_;
+		std::function<void(boost::asio::io_service&)> initializer_;
 
 	};
 
@@ -73,12 +91,38 @@ public:
 		Stop();
 	}
 
+	//第i个工作线程绑定到cpu_sets[i % cpu_sets.size()]中的CPU上,空表示不绑定,在Start之前调用
+	void SetCpuAffinity(std::vector<std::vector<uint32_t>> cpu_sets)
+	{
+		cpu_sets_ = std::move(cpu_sets);
+	}
+
+	//按NUMA节点和物理核自动分配,每个工作线程一个逻辑CPU,见cpuaffinity::AutoAssign,在Start之前调用
+	void SetAutoCpuAffinity()
+	{
+		cpu_sets_ = cpuaffinity::AutoAssign(ios_workers_.size());
+	}
+
+	const std::vector<std::vector<uint32_t>>& GetCpuAffinity() const { return cpu_sets_; }
+
+	//每个工作线程绑定CPU之后、run之前在该线程里调用,用于在本地NUMA节点上预先创建每个io_service的状态,在Start之前调用
+	void SetWorkerInitializer(std::function<void(boost::asio::io_service&)> initializer)
+	{
+		initializer_ = std::move(initializer);
+	}
+
+	size_t GetPoolSize() const { return ios_workers_.size(); }
+
 	bool Start()
 	{
 		try
 		{
+			size_t index = 0;
 			for (auto& ios_worker : ios_workers_)
-				ios_worker.Start();
+			{
+				ios_worker.Start(cpu_sets_.empty() ? std::vector<uint32_t>() : cpu_sets_[index % cpu_sets_.size()], initializer_);
+				++index;
+			}
 		}
 		catch (std::exception& e)
 		{
@@ -112,5 +156,7 @@ public:
 private:
 	std::list<IosWorker>		ios_workers_;
 	iterator					next_io_service_;
+	std::vector<std::vector<uint32_t>> cpu_sets_;
+	std::function<void(boost::asio::io_service&)> initializer_;
 };
 
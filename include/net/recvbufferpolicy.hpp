@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include "tcpsessioncallback.h"
+
+//接收缓冲区自适应策略
+//  每次读把缓冲区读满时容量翻倍,直到max_size
+//  连续shrink_after_small_reads次读到的数据不足容量的1/4,且缓冲区已经没有未处理的数据时,容量减半,直到min_size
+//  Framer为了放下整包而扩容(ReserveRecvBuffer)不受max_size限制,包处理完后同样按上面的规则缩回
+//  环形缓冲区的容量按页向上取整
+struct RecvBufferPolicy
+{
+	uint32_t initial_size_ = kRecvBufferSize;
+	uint32_t min_size_ = kRecvBufferSize;
+	uint32_t max_size_ = 256 * 1024;
+	uint32_t shrink_after_small_reads_ = 16;	//0表示不缩小
+	bool ring_ = false;		//使用双重映射的环形缓冲区(DataBuffer::EnableRing),未处理完的数据不再在每次读之前memmove,平台不支持时退回普通缓冲区
+	bool pooled_ = false;	//空闲时不持有接收缓冲区:先等socket可读,再从本io线程的RecvBufferPool借initial_size_的缓冲区,数据处理完就还
+};
+
+//所有session接收缓冲区的总字节数,超过上限后自适应策略不再扩容(Framer整包扩容除外)
+class RecvBufferBudget
+{
+public:
+	//0表示不限制
+	static void SetLimit(uint64_t bytes) { Limit().store(bytes, std::memory_order_relaxed); }
+	static uint64_t GetLimit() { return Limit().load(std::memory_order_relaxed); }
+
+	static uint64_t GetTotal() { return Total().load(std::memory_order_relaxed); }
+
+	//申请额外的bytes字节,超过上限时返回false且不计入
+	static bool TryAcquire(uint64_t bytes)
+	{
+		uint64_t limit = GetLimit();
+		if (limit == 0)
+		{
+			Total().fetch_add(bytes, std::memory_order_relaxed);
+			return true;
+		}
+
+		uint64_t total = Total().load(std::memory_order_relaxed);
+		do
+		{
+			if (total + bytes > limit)
+				return false;
+		} while (!Total().compare_exchange_weak(total, total + bytes, std::memory_order_relaxed));
+
+		return true;
+	}
+
+	static void Acquire(uint64_t bytes) { Total().fetch_add(bytes, std::memory_order_relaxed); }
+	static void Release(uint64_t bytes) { Total().fetch_sub(bytes, std::memory_order_relaxed); }
+
+private:
+	static std::atomic<uint64_t>& Total()
+	{
+		static std::atomic<uint64_t> total(0);
+		return total;
+	}
+
+	static std::atomic<uint64_t>& Limit()
+	{
+		static std::atomic<uint64_t> limit(0);
+		return limit;
+	}
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "buffer/databuffer.hpp"
+#include "buffer/ringmemory.hpp"
+
+//接收缓冲区池,每个io线程一份(thread_local),借还都在session所属的io线程里进行,不需要加锁
+//RecvBufferPolicy::pooled_打开时session空闲期间不持有接收缓冲区,socket可读时才借,数据处理完就还
+class RecvBufferPool
+{
+public:
+	//每种容量在每个线程里最多缓存的缓冲区数,多出来的直接释放
+	static const size_t kMaxPooledPerClass = 256;
+
+	struct Stats
+	{
+		uint64_t lent_;			//当前借出(被session持有)的缓冲区数
+		uint64_t pooled_;		//所有线程池中空闲的缓冲区数
+		uint64_t pooled_bytes_;	//所有线程池中空闲缓冲区的字节数
+		uint64_t waiting_;		//不持有缓冲区、正在等待可读的session数
+	};
+
+	//借一个容量为capacity的缓冲区,ring为true时尽量使用环形缓冲区
+	static DataBuffer Borrow(uint32_t capacity, bool ring)
+	{
+		uint32_t actual = ring ? (uint32_t)ringmemory::RoundUp(capacity) : capacity;
+		SizeClass& size_class = GetSizeClass(actual, ring);
+
+		Counters().lent_.fetch_add(1, std::memory_order_relaxed);
+
+		if (!size_class.buffers_.empty())
+		{
+			DataBuffer buffer(std::move(size_class.buffers_.back()));
+			size_class.buffers_.pop_back();
+
+			Counters().pooled_.fetch_sub(1, std::memory_order_relaxed);
+			Counters().pooled_bytes_.fetch_sub(buffer.GetCapacitySize(), std::memory_order_relaxed);
+			return buffer;
+		}
+
+		DataBuffer buffer(capacity);
+		if (ring && !buffer.EnableRing(capacity))
+			GetSizeClass(capacity, false);	//平台不支持环形缓冲区,按普通缓冲区回收
+		return buffer;
+	}
+
+	//归还buffer,之后buffer为空(容量为0);借出后容量变过的缓冲区不放回池里,直接释放
+	static void Return(DataBuffer& buffer)
+	{
+		if (buffer.GetCapacitySize() == 0)
+			return;
+
+		Counters().lent_.fetch_sub(1, std::memory_order_relaxed);
+
+		SizeClass* size_class = FindSizeClass(buffer.GetCapacitySize(), buffer.IsRing());
+		if (size_class == nullptr || size_class->buffers_.size() >= kMaxPooledPerClass)
+		{
+			buffer = DataBuffer();
+			return;
+		}
+
+		buffer.SetWritePos(0);
+		buffer.SetReadPos(0);
+
+		Counters().pooled_.fetch_add(1, std::memory_order_relaxed);
+		Counters().pooled_bytes_.fetch_add(buffer.GetCapacitySize(), std::memory_order_relaxed);
+
+		size_class->buffers_.push_back(std::move(buffer));
+	}
+
+	//session析构时可能不在io线程,直接释放不放回池里
+	static void Discard(DataBuffer& buffer)
+	{
+		if (buffer.GetCapacitySize() == 0)
+			return;
+
+		Counters().lent_.fetch_sub(1, std::memory_order_relaxed);
+		buffer = DataBuffer();
+	}
+
+	static void AddWaiting() { Counters().waiting_.fetch_add(1, std::memory_order_relaxed); }
+	static void RemoveWaiting() { Counters().waiting_.fetch_sub(1, std::memory_order_relaxed); }
+
+	static Stats GetStats()
+	{
+		Stats stats;
+		stats.lent_ = Counters().lent_.load(std::memory_order_relaxed);
+		stats.pooled_ = Counters().pooled_.load(std::memory_order_relaxed);
+		stats.pooled_bytes_ = Counters().pooled_bytes_.load(std::memory_order_relaxed);
+		stats.waiting_ = Counters().waiting_.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+private:
+	struct SizeClass
+	{
+		uint32_t capacity_;
+		bool ring_;
+		std::vector<DataBuffer> buffers_;
+	};
+
+	struct LocalPool
+	{
+		~LocalPool()
+		{
+			for (auto& size_class : size_classes_)
+			{
+				for (auto& buffer : size_class.buffers_)
+				{
+					Counters().pooled_.fetch_sub(1, std::memory_order_relaxed);
+					Counters().pooled_bytes_.fetch_sub(buffer.GetCapacitySize(), std::memory_order_relaxed);
+				}
+			}
+		}
+
+		//通常只有一两种容量,线性查找即可
+		std::vector<SizeClass> size_classes_;
+	};
+
+	struct GlobalCounters
+	{
+		std::atomic<uint64_t> lent_{ 0 };
+		std::atomic<uint64_t> pooled_{ 0 };
+		std::atomic<uint64_t> pooled_bytes_{ 0 };
+		std::atomic<uint64_t> waiting_{ 0 };
+	};
+
+	static LocalPool& Local()
+	{
+		static thread_local LocalPool pool;
+		return pool;
+	}
+
+	static GlobalCounters& Counters()
+	{
+		static GlobalCounters counters;
+		return counters;
+	}
+
+	static SizeClass* FindSizeClass(uint32_t capacity, bool ring)
+	{
+		for (auto& size_class : Local().size_classes_)
+		{
+			if (size_class.capacity_ == capacity && size_class.ring_ == ring)
+				return &size_class;
+		}
+		return nullptr;
+	}
+
+	static SizeClass& GetSizeClass(uint32_t capacity, bool ring)
+	{
+		SizeClass* size_class = FindSizeClass(capacity, ring);
+		if (size_class != nullptr)
+			return *size_class;
+
+		Local().size_classes_.push_back(SizeClass{ capacity, ring, std::vector<DataBuffer>() });
+		return Local().size_classes_.back();
+	}
+};
@@ -0,0 +1,166 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string.h>
+#include "buffer/endianconversion.hpp"
+
+//RTT心跳的探测字段:序号(uint32_t)和发送时间(微秒,uint64_t),大端,共12字节
+//发送方把它嵌在心跳报文里,对端原样回显,发送方用回显的发送时间计算RTT,不需要保存未确认的探测
+struct RttProbe
+{
+	static const uint32_t kSize = 12;
+	static const uint32_t kNone = 0xFFFFFFFF;	//心跳里没有探测字段
+
+	static void Encode(uint8_t* p, uint32_t seq, uint64_t send_microseconds)
+	{
+		endian::HToBe(seq);
+		endian::HToBe(send_microseconds);
+		memcpy(p, &seq, sizeof(seq));
+		memcpy(p + sizeof(seq), &send_microseconds, sizeof(send_microseconds));
+	}
+
+	static void Decode(const uint8_t* p, uint32_t& seq, uint64_t& send_microseconds)
+	{
+		memcpy(&seq, p, sizeof(seq));
+		memcpy(&send_microseconds, p + sizeof(seq), sizeof(send_microseconds));
+		endian::BeToH(seq);
+		endian::BeToH(send_microseconds);
+	}
+
+	//单调时钟的微秒数,只在本进程内有意义
+	static uint64_t NowMicroseconds()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+};
+
+//平滑RTT和抖动,算法同TCP(RFC 6298):srtt = 7/8*srtt + 1/8*rtt, rttvar = 3/4*rttvar + 1/4*|srtt - rtt|
+//在io线程里更新,其它线程可以随时读取
+class RttEstimator
+{
+public:
+	RttEstimator() :srtt_(0), rttvar_(0), last_(0), samples_(0) {}
+
+	void AddSample(uint64_t rtt_microseconds)
+	{
+		uint64_t srtt = srtt_.load(std::memory_order_relaxed);
+		uint64_t rttvar = rttvar_.load(std::memory_order_relaxed);
+		if (samples_.load(std::memory_order_relaxed) == 0)
+		{
+			srtt = rtt_microseconds;
+			rttvar = rtt_microseconds / 2;
+		}
+		else
+		{
+			uint64_t delta = srtt > rtt_microseconds ? srtt - rtt_microseconds : rtt_microseconds - srtt;
+			rttvar = (rttvar * 3 + delta) / 4;
+			srtt = (srtt * 7 + rtt_microseconds) / 8;
+		}
+
+		srtt_.store(srtt, std::memory_order_relaxed);
+		rttvar_.store(rttvar, std::memory_order_relaxed);
+		last_.store(rtt_microseconds, std::memory_order_relaxed);
+		samples_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	uint64_t GetSmoothedMicroseconds() const { return srtt_.load(std::memory_order_relaxed); }
+	uint64_t GetVarianceMicroseconds() const { return rttvar_.load(std::memory_order_relaxed); }
+	uint64_t GetLastMicroseconds() const { return last_.load(std::memory_order_relaxed); }
+	uint64_t GetSamples() const { return samples_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> srtt_;
+	std::atomic<uint64_t> rttvar_;
+	std::atomic<uint64_t> last_;
+	std::atomic<uint64_t> samples_;
+};
+
+//延迟直方图,多个io线程并发Record,按2的幂分桶(第i个桶是[2^(i-1), 2^i)微秒),分位数的误差在一倍以内
+class LatencyHistogram
+{
+public:
+	static const uint32_t kBuckets = 40;
+
+	LatencyHistogram()
+	{
+		Reset();
+	}
+
+	void Record(uint64_t microseconds)
+	{
+		uint32_t bucket = 0;
+		while (bucket + 1 < kBuckets && microseconds >= ((uint64_t)1 << bucket))
+			++bucket;
+
+		buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+		count_.fetch_add(1, std::memory_order_relaxed);
+		sum_.fetch_add(microseconds, std::memory_order_relaxed);
+
+		uint64_t max = max_.load(std::memory_order_relaxed);
+		while (microseconds > max && !max_.compare_exchange_weak(max, microseconds, std::memory_order_relaxed))
+			;
+	}
+
+	uint64_t GetCount() const { return count_.load(std::memory_order_relaxed); }
+	uint64_t GetMaxMicroseconds() const { return max_.load(std::memory_order_relaxed); }
+
+	uint64_t GetMeanMicroseconds() const
+	{
+		uint64_t count = GetCount();
+		return count == 0 ? 0 : sum_.load(std::memory_order_relaxed) / count;
+	}
+
+	//percentile取值(0,100],返回所在桶的上界(不超过最大值),没有样本时返回0
+	uint64_t GetPercentileMicroseconds(double percentile) const
+	{
+		uint64_t counts[kBuckets];
+		uint64_t total = 0;
+		for (uint32_t i = 0; i < kBuckets; ++i)
+		{
+			counts[i] = buckets_[i].load(std::memory_order_relaxed);
+			total += counts[i];
+		}
+		if (total == 0)
+			return 0;
+
+		uint64_t rank = (uint64_t)(total * percentile / 100.0 + 0.5);
+		if (rank == 0)
+			rank = 1;
+
+		uint64_t max = GetMaxMicroseconds();
+		uint64_t seen = 0;
+		for (uint32_t i = 0; i + 1 < kBuckets; ++i)
+		{
+			seen += counts[i];
+			if (seen >= rank)
+				return ((uint64_t)1 << i) < max ? ((uint64_t)1 << i) : max;
+		}
+		return max;
+	}
+
+	//每个桶的计数,下标含义见类说明
+	std::vector<uint64_t> GetBuckets() const
+	{
+		std::vector<uint64_t> counts(kBuckets);
+		for (uint32_t i = 0; i < kBuckets; ++i)
+			counts[i] = buckets_[i].load(std::memory_order_relaxed);
+		return counts;
+	}
+
+	void Reset()
+	{
+		for (auto& bucket : buckets_)
+			bucket.store(0, std::memory_order_relaxed);
+		count_.store(0, std::memory_order_relaxed);
+		sum_.store(0, std::memory_order_relaxed);
+		max_.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint64_t> buckets_[kBuckets];
+	std::atomic<uint64_t> count_;
+	std::atomic<uint64_t> sum_;
+	std::atomic<uint64_t> max_;
+};
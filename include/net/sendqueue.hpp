@@ -0,0 +1,153 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include "boost/noncopyable.hpp"
+#include "buffer/sharedbuffer.hpp"
+
+//发送队列节点,由生产者new出来,io线程写完后delete
+//数据要么由节点自己持有(std::string),要么是共享的SharedBuffer(多个session共用一份内存)
+struct SendNode
+{
+	explicit SendNode(std::string data) :next_(nullptr), data_(std::move(data))
+	{
+		ptr_ = data_.data();
+		size_ = data_.size();
+	}
+
+	explicit SendNode(SharedBuffer buffer) :next_(nullptr), buffer_(std::move(buffer))
+	{
+		ptr_ = buffer_.GetData();
+		size_ = buffer_.GetSize();
+	}
+
+	const void* GetData() const { return ptr_; }
+	size_t GetSize() const { return size_; }
+
+	SendNode* next_;
+	std::string data_;
+	SharedBuffer buffer_;
+	const void* ptr_;
+	size_t size_;
+};
+
+//侵入式无锁多生产者/单消费者发送队列
+//生产者只需一次成功的CAS就能入队,并且能知道自己是否需要启动写操作;
+//消费者(session所在的io线程)每次把已入队的节点整体取走,按FIFO顺序批量发送.
+//
+//head_的取值:
+//  nullptr    空闲,没有写操作在进行
+//  Busy()     写操作进行中,没有新节点
+//  其它       新入队节点组成的栈(LIFO),栈底的next_为nullptr或Busy()
+class SendQueue : boost::noncopyable
+{
+public:
+	SendQueue() :head_(nullptr), front_(nullptr), back_(nullptr) {}
+	~SendQueue()
+	{
+		Clear();
+	}
+
+	//生产者调用,返回true表示队列原本空闲,调用者负责(在io线程)启动写操作
+	bool Push(SendNode* node)
+	{
+		SendNode* old = head_.load(std::memory_order_relaxed);
+		do
+		{
+			node->next_ = old;
+		} while (!head_.compare_exchange_weak(old, node, std::memory_order_release, std::memory_order_relaxed));
+
+		return old == nullptr;
+	}
+
+	//一次入队多个节点,保证它们在队列里连续,不会和其它生产者的节点交错
+	//节点已经按newest->...->oldest用next_串好(和栈内顺序一致)
+	bool Push(SendNode* newest, SendNode* oldest)
+	{
+		SendNode* old = head_.load(std::memory_order_relaxed);
+		do
+		{
+			oldest->next_ = old;
+		} while (!head_.compare_exchange_weak(old, newest, std::memory_order_release, std::memory_order_relaxed));
+
+		return old == nullptr;
+	}
+
+	//消费者调用,把新入队的节点按FIFO顺序追加到待发送链表
+	void Collect()
+	{
+		SendNode* stack = head_.exchange(Busy(), std::memory_order_acquire);
+
+		SendNode* reversed = nullptr;
+		SendNode* last = nullptr;
+		while (stack != nullptr && stack != Busy())
+		{
+			SendNode* next = stack->next_;
+			stack->next_ = reversed;
+			if (reversed == nullptr)
+				last = stack;
+			reversed = stack;
+			stack = next;
+		}
+
+		if (reversed != nullptr)
+		{
+			if (back_ != nullptr)
+				back_->next_ = reversed;
+			else
+				front_ = reversed;
+			back_ = last;
+		}
+	}
+
+	//消费者调用,待发送链表为空时尝试回到空闲状态;返回false表示期间又有新节点入队,需要再次Collect
+	bool Release()
+	{
+		SendNode* expected = Busy();
+		return head_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel, std::memory_order_relaxed);
+	}
+
+	//没有写操作在进行,也没有排队的节点
+	bool IsIdle() const
+	{
+		return head_.load(std::memory_order_acquire) == nullptr;
+	}
+
+	//以下只能由消费者调用
+	SendNode* Front() { return front_; }
+
+	bool Empty() const { return front_ == nullptr; }
+
+	void PopFront(size_t count)
+	{
+		while (count-- != 0 && front_ != nullptr)
+		{
+			SendNode* node = front_;
+			front_ = node->next_;
+			delete node;
+		}
+
+		if (front_ == nullptr)
+			back_ = nullptr;
+	}
+
+	//session析构时调用,此时已没有生产者和消费者
+	void Clear()
+	{
+		Collect();
+		PopFront(SIZE_MAX);
+		head_.store(nullptr, std::memory_order_relaxed);
+	}
+
+private:
+	static SendNode* Busy()
+	{
+		return reinterpret_cast<SendNode*>(uintptr_t(1));
+	}
+
+	std::atomic<SendNode*> head_;
+
+	//消费者私有的待发送链表
+	SendNode* front_;
+	SendNode* back_;
+};
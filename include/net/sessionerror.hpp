@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include "boost/system/error_code.hpp"
+
+//session自己产生的错误,通过OnClose的error_code传给应用
+enum class SessionError :int
+{
+	kWriteStalled = 1,		//发送队列非空,但在规定时间内没有任何数据写出
+	kInvalidFrame,			//包头解析失败
+	kFrameTooLarge,			//包长度超过上限
+};
+
+class SessionErrorCategory : public boost::system::error_category
+{
+public:
+	const char* name() const BOOST_SYSTEM_NOEXCEPT
+	{
+		return "session";
+	}
+
+	std::string message(int value) const
+	{
+		switch (static_cast<SessionError>(value))
+		{
+		case SessionError::kWriteStalled:
+			return "Write stalled: peer stopped reading";
+		case SessionError::kInvalidFrame:
+			return "Invalid frame header";
+		case SessionError::kFrameTooLarge:
+			return "Frame exceeds maximum size";
+		default:
+			return "Unknown session error";
+		}
+	}
+};
+
+inline const boost::system::error_category& GetSessionErrorCategory()
+{
+	static SessionErrorCategory instance;
+	return instance;
+}
+
+inline boost::system::error_code make_error_code(SessionError e)
+{
+	return boost::system::error_code(static_cast<int>(e), GetSessionErrorCategory());
+}
+
+namespace boost
+{
+	namespace system
+	{
+		template<>
+		struct is_error_code_enum<SessionError> : public std::true_type {};
+	}
+}
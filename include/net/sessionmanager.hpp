@@ -1,7 +1,10 @@
 #pragma once
 #include <memory>
 #include <mutex>
+#include <vector>
 #include<unordered_map>
+#include "boost/asio.hpp"
+#include "buffer/sharedbuffer.hpp"
 
 
 template <typename TSession>
@@ -13,16 +16,51 @@ public:
 	bool Insert(std::shared_ptr<TSession> spsession);
 	std::shared_ptr<TSession> Get(uint64_t sessionid);
 	bool Remove(uint64_t sessionid);
+
+	//发给所有session,按session所属的io_service分组,每个io线程只投递一个批量任务
+	//返回投递时的目标session数
+	size_t Broadcast(const SharedBuffer& payload);
+
+	//发给指定id的session
+	size_t Multicast(const std::vector<uint64_t>& sessionids, const SharedBuffer& payload);
+
+	//发给满足条件的session,predicate在session所属的io线程里调用
+	template <typename Predicate>
+	size_t Multicast(Predicate predicate, const SharedBuffer& payload);
+
+	//score最小的session,score在调用线程里持锁计算,应当只读session的原子状态;没有session时返回空
+	template <typename Score>
+	std::shared_ptr<TSession> FindMin(Score score);
+
 private:
+	using SessionBatch = std::vector<std::weak_ptr<TSession>>;
+	using IosBatches = std::unordered_map<boost::asio::io_service*, SessionBatch>;
+
+	template <typename Predicate>
+	static void PostBatches(IosBatches& batches, const Predicate& predicate, const SharedBuffer& payload);
+
+	struct SessionEntry
+	{
+		std::weak_ptr<TSession> session_;
+		boost::asio::io_service* ios_;
+	};
+
 	std::mutex session_mutex_;
-	std::unordered_map<uint64_t, std::weak_ptr<TSession>>  session_map_;
+	std::unordered_map<uint64_t, SessionEntry>  session_map_;
+	std::unordered_map<boost::asio::io_service*, std::unordered_map<uint64_t, std::weak_ptr<TSession>>> ios_session_map_;
 };
 
 template <typename TSession>
 inline bool SessionManager<TSession>::Insert(std::shared_ptr<TSession> spsession)
 {
+	boost::asio::io_service* ios = &spsession->GetIoService();
+
 	std::unique_lock<std::mutex> lock1(session_mutex_);
-	auto apair = session_map_.emplace(spsession->GetSessionID(), spsession);
+	auto apair = session_map_.emplace(spsession->GetSessionID(), SessionEntry{ spsession, ios });
+	if (apair.second)
+	{
+		ios_session_map_[ios].emplace(spsession->GetSessionID(), spsession);
+	}
 	return apair.second;
 }
 
@@ -33,7 +71,7 @@ inline std::shared_ptr<TSession> SessionManager<TSession>::Get(uint64_t sessioni
 	auto it = session_map_.find(sessionid);
 	if (it != session_map_.end())
 	{
-		return it->second.lock();
+		return it->second.session_.lock();
 	}
 
 	return std::shared_ptr<TSession>();
@@ -43,6 +81,113 @@ template <typename TSession>
 inline bool SessionManager<TSession>::Remove(uint64_t sessionid)
 {
 	std::unique_lock<std::mutex> lock1(session_mutex_);
-	return session_map_.erase(sessionid);
+	auto it = session_map_.find(sessionid);
+	if (it == session_map_.end())
+		return false;
+
+	auto ios_it = ios_session_map_.find(it->second.ios_);
+	if (ios_it != ios_session_map_.end())
+	{
+		ios_it->second.erase(sessionid);
+		if (ios_it->second.empty())
+			ios_session_map_.erase(ios_it);
+	}
+
+	session_map_.erase(it);
+	return true;
+}
+
+template <typename TSession>
+inline size_t SessionManager<TSession>::Broadcast(const SharedBuffer& payload)
+{
+	return Multicast([](const std::shared_ptr<TSession>&) { return true; }, payload);
+}
+
+template <typename TSession>
+inline size_t SessionManager<TSession>::Multicast(const std::vector<uint64_t>& sessionids, const SharedBuffer& payload)
+{
+	IosBatches batches;
+	size_t count = 0;
+
+	{
+		std::unique_lock<std::mutex> lock1(session_mutex_);
+		for (auto sessionid : sessionids)
+		{
+			auto it = session_map_.find(sessionid);
+			if (it != session_map_.end())
+			{
+				batches[it->second.ios_].push_back(it->second.session_);
+				++count;
+			}
+		}
+	}
+
+	PostBatches(batches, [](const std::shared_ptr<TSession>&) { return true; }, payload);
+
+	return count;
+}
+
+template <typename TSession>
+template <typename Predicate>
+inline size_t SessionManager<TSession>::Multicast(Predicate predicate, const SharedBuffer& payload)
+{
+	IosBatches batches;
+	size_t count = 0;
+
+	{
+		std::unique_lock<std::mutex> lock1(session_mutex_);
+		for (auto& ios_sessions : ios_session_map_)
+		{
+			auto& batch = batches[ios_sessions.first];
+			batch.reserve(ios_sessions.second.size());
+			for (auto& session : ios_sessions.second)
+			{
+				batch.push_back(session.second);
+			}
+			count += batch.size();
+		}
+	}
+
+	PostBatches(batches, predicate, payload);
+
+	return count;
+}
+
+template <typename TSession>
+template <typename Score>
+inline std::shared_ptr<TSession> SessionManager<TSession>::FindMin(Score score)
+{
+	std::shared_ptr<TSession> best;
+	std::unique_lock<std::mutex> lock1(session_mutex_);
+	for (auto& entry : session_map_)
+	{
+		auto session = entry.second.session_.lock();
+		if (session == nullptr)
+			continue;
+
+		if (best == nullptr || score(session) < score(best))
+			best = std::move(session);
+	}
+
+	return best;
 }
 
+template <typename TSession>
+template <typename Predicate>
+inline void SessionManager<TSession>::PostBatches(IosBatches& batches, const Predicate& predicate, const SharedBuffer& payload)
+{
+	for (auto& batch : batches)
+	{
+		batch.first->post([sessions = std::move(batch.second), predicate, payload]() {
+
+			for (auto& weak_session : sessions)
+			{
+				auto session = weak_session.lock();
+				if (session != nullptr && predicate(session))
+				{
+					session->Send(payload);
+				}
+			}
+		});
+	}
+}
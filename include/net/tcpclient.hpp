@@ -1,14 +1,18 @@
 #pragma once
 #include <thread>
 #include <atomic>
+#include <limits>
 #include "tcpsession.hpp"
 #include "sessionmanager.hpp"
 
 template <typename TSession>
-class TcpClient :boost::noncopyable
+class TcpClient :public FrameHandler<TSession, typename TSession::FramerType>, boost::noncopyable
 {
 public:
+	using Framer = typename TSession::FramerType;
+
 	TcpClient() :ios_(), work_(/*std::make_unique<boost::asio::io_service::work>(ios_)*/new boost::asio::io_service::work(ios_)), id_(0)
+		, write_high_watermark_(0), write_low_watermark_(0), write_stall_timeout_milliseconds_(0), idle_policy_(IdlePolicy::kTimer), heartbeat_intervals_seconds_(0), rtt_probe_offset_(RttProbe::kNone)
 	{
 		is_running_ = false;
 	}
@@ -41,13 +45,23 @@ public:
 		session_mng_.Remove(spsession->GetSessionID());
 	};
 
-#ifdef 	  SOCKET_HEADER_BODY_MODE
-	virtual uint32_t OnGetHeaderLength() = 0;
-	virtual int32_t OnGetBodyLength(std::shared_ptr<TSession> spsession, std::vector<uint8_t>& header) = 0;
-	virtual int32_t OnMessage(std::shared_ptr<TSession> spsession, std::vector<uint8_t>& header, std::vector<uint8_t>& body) = 0;
-#else
-	virtual uint32_t OnRecv(std::shared_ptr<TSession> spsession, DataBuffer& recv_data) = 0;
-#endif // 
+	virtual void OnWriteBlocked(std::shared_ptr<TSession> spsession, size_t queued_bytes)
+	{
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,SessionID:%llu,QueuedBytes:%zu\n", __FILE__, __FUNCTION__, __LINE__, (unsigned long long)spsession->GetSessionID(), queued_bytes);
+	}
+
+	virtual void OnWriteDrained(std::shared_ptr<TSession> spsession, size_t queued_bytes)
+	{
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,SessionID:%llu,QueuedBytes:%zu\n", __FILE__, __FUNCTION__, __LINE__, (unsigned long long)spsession->GetSessionID(), queued_bytes);
+	}
+
+	//分包回调OnRecv/OnGetHeaderLength/OnGetBodyLength/OnMessage见FrameHandler,TSession的Framer用到的必须重写
+
+	//新连接使用的分包配置,每个session拷贝一份
+	Framer& GetFramer()
+	{
+		return framer_;
+	}
 
 public:
 	std::shared_ptr<TSession> Connect(std::string ip, uint16_t port, uint32_t delay_seconds = 0, uint32_t connect_timeout_seconds = 0)
@@ -59,14 +73,18 @@ public:
 
 		new_session->SetConnectFailureCallback(std::bind(&TcpClient::OnConnectFailure, this, std::placeholders::_1, std::placeholders::_2));
 
-#if SOCKET_HEADER_BODY_MODE
-		new_session->SetMessageLengthCallback(std::bind(&TcpClient::OnGetHeaderLength, this), std::bind(&TcpClient::OnGetBodyLength, this, std::placeholders::_1, std::placeholders::_2));
-		new_session->SetMessageCallback(std::bind(&TcpClient::OnMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-#else
-		new_session->SetRecvCallback(std::bind(&TcpClient::OnRecv, this, std::placeholders::_1, std::placeholders::_2));
-#endif
+		new_session->SetFramer(framer_);
+		new_session->SetFrameHandler(this);
 
 		new_session->SetCloseCallback(std::bind(&TcpClient::OnClose, this, std::placeholders::_1, std::placeholders::_2));
+		new_session->SetWriteWatermarkCallback(std::bind(&TcpClient::OnWriteBlocked, this, std::placeholders::_1, std::placeholders::_2),
+			std::bind(&TcpClient::OnWriteDrained, this, std::placeholders::_1, std::placeholders::_2));
+		new_session->SetWriteWatermark(write_high_watermark_, write_low_watermark_);
+		new_session->SetWriteStallTimeout(write_stall_timeout_milliseconds_);
+		new_session->SetRecvBufferPolicy(recv_buffer_policy_);
+		new_session->SetIdlePolicy(idle_policy_);
+		new_session->InitHeartbeat(heartbeat_payload_, heartbeat_intervals_seconds_, rtt_probe_offset_);
+		new_session->SetRttHistogram(&rtt_histogram_);
 
 		new_session->Connect(ip, port, delay_seconds, connect_timeout_seconds);
 
@@ -114,6 +132,75 @@ public:
 		return is_running_;
 	}
 
+	//之后Connect创建的session的发送队列高低水位,见TcpSession::SetWriteWatermark
+	void SetWriteWatermark(size_t high, size_t low)
+	{
+		write_high_watermark_ = high;
+		write_low_watermark_ = low;
+	}
+
+	//之后Connect创建的session的写停滞超时(毫秒),见TcpSession::SetWriteStallTimeout
+	void SetWriteStallTimeout(uint32_t milliseconds)
+	{
+		write_stall_timeout_milliseconds_ = milliseconds;
+	}
+
+	//之后Connect创建的session的接收缓冲区自适应策略,见RecvBufferPolicy,在Connect之前调用
+	//所有session接收缓冲区的总上限用RecvBufferBudget::SetLimit设置
+	void SetRecvBufferPolicy(const RecvBufferPolicy& policy) { recv_buffer_policy_ = policy; }
+	const RecvBufferPolicy& GetRecvBufferPolicy() const { return recv_buffer_policy_; }
+
+	//之后Connect创建的session的接收超时检测方式,见IdlePolicy,在Connect之前调用
+	void SetIdlePolicy(IdlePolicy policy) { idle_policy_ = policy; }
+	IdlePolicy GetIdlePolicy() const { return idle_policy_; }
+
+	//之后Connect创建的session的心跳,info只编码一次,所有session共享同一份payload,在Connect之前调用
+	//每个io线程的心跳都由该线程的时间轮驱动,有数据写出的session只顺延不发送,见TcpSession::SetHeartbeat
+	void SetHeartbeat(std::string info, uint32_t heartbeat_intervals_seconds)
+	{
+		heartbeat_payload_ = SharedBuffer(std::move(info));
+		heartbeat_intervals_seconds_ = heartbeat_intervals_seconds;
+		rtt_probe_offset_ = RttProbe::kNone;
+	}
+
+	//之后Connect创建的session使用RTT心跳,见TcpSession::SetRttHeartbeat,在Connect之前调用
+	//所有session的RTT采样汇总到GetRttHistogram
+	void SetRttHeartbeat(std::string payload, uint32_t probe_offset, uint32_t heartbeat_intervals_seconds)
+	{
+		if ((uint64_t)probe_offset + RttProbe::kSize > payload.size())
+			throw std::invalid_argument("SetRttHeartbeat exception:probe exceeds payload size");
+
+		heartbeat_payload_ = SharedBuffer(std::move(payload));
+		heartbeat_intervals_seconds_ = heartbeat_intervals_seconds;
+		rtt_probe_offset_ = probe_offset;
+	}
+
+	LatencyHistogram& GetRttHistogram() { return rtt_histogram_; }
+
+	//平滑RTT最小的已连接session,用于把请求路由到最快的上游;还没有RTT采样的session排在最后
+	std::shared_ptr<TSession> GetFastestSession()
+	{
+		return session_mng_.FindMin([](const std::shared_ptr<TSession>& session) {
+			return (session->IsConnect() && session->GetRttSamples() != 0) ? session->GetSmoothedRtt().count() : std::numeric_limits<int64_t>::max();
+		});
+	}
+
+	size_t Broadcast(const SharedBuffer& payload)
+	{
+		return session_mng_.Broadcast(payload);
+	}
+
+	size_t Multicast(const std::vector<uint64_t>& sessionids, const SharedBuffer& payload)
+	{
+		return session_mng_.Multicast(sessionids, payload);
+	}
+
+	template <typename Predicate>
+	size_t Multicast(Predicate predicate, const SharedBuffer& payload)
+	{
+		return session_mng_.Multicast(predicate, payload);
+	}
+
 protected:
 	/*void Connect(std::shared_ptr<TSession> spsession, std::string ip, uint16_t port, uint32_t delay_seconds = 0, uint32_t connect_timeout_seconds = 0)
 	{
@@ -132,4 +219,14 @@ protected:
 	std::atomic<uint64_t> id_;
 	SessionManager<TSession> session_mng_;
 	bool is_running_;
+	std::atomic<size_t> write_high_watermark_;
+	std::atomic<size_t> write_low_watermark_;
+	std::atomic<uint32_t> write_stall_timeout_milliseconds_;
+	Framer framer_;
+	RecvBufferPolicy recv_buffer_policy_;
+	IdlePolicy idle_policy_;
+	SharedBuffer heartbeat_payload_;
+	uint32_t heartbeat_intervals_seconds_;
+	uint32_t rtt_probe_offset_;
+	LatencyHistogram rtt_histogram_;
 };
\ No newline at end of file
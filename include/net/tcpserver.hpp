@@ -10,11 +10,21 @@
 #include "sessionmanager.hpp"
 
 template <typename TSession>
-class TcpServer :boost::noncopyable
+class TcpServer :public FrameHandler<TSession, typename TSession::FramerType>, boost::noncopyable
 {
 public:
+	using Framer = typename TSession::FramerType;
+
 	TcpServer(uint16_t port, size_t pool_size = std::thread::hardware_concurrency()) :ios_pool_(pool_size),
-		acceptor_(ios_pool_.GetIoService(), boost::asio::ip::tcp::endpoint{ boost::asio::ip::tcp::v4(), port }), id_(0), is_running_(false) {};
+		acceptor_(ios_pool_.GetIoService(), boost::asio::ip::tcp::endpoint{ boost::asio::ip::tcp::v4(), port }), id_(0), is_running_(false)
+		, write_high_watermark_(0), write_low_watermark_(0), write_stall_timeout_milliseconds_(0), idle_policy_(IdlePolicy::kTimer), heartbeat_intervals_seconds_(0), rtt_probe_offset_(RttProbe::kNone)
+	{
+		//每个io_service的时间轮和空闲扫描在各自的工作线程run之前创建,之后session(也在该线程里创建)只会取到已有的服务
+		ios_pool_.SetWorkerInitializer([](boost::asio::io_service& ios) {
+			boost::asio::use_service<TimingWheel>(ios);
+			boost::asio::use_service<IdleSweeper>(ios);
+		});
+	};
 	virtual ~TcpServer();
 	void Start()
 	{
@@ -34,24 +44,101 @@ public:
 		is_running_ = false;
 	}
 
-	bool TcpSend(uint64_t sessionid, const std::string& data)
+	SendResult TcpSend(uint64_t sessionid, std::string data)
 	{
 		auto session = session_mng_.Get(sessionid);
 		if (session != NULL)
 		{
-			session->Send(data);
+			return session->Send(std::move(data));
 		}
 
-		return false;
+		return SendResult::kSendNotConnected;
+	}
+
+	SendResult TcpSend(uint64_t sessionid, const SharedBuffer& buffer)
+	{
+		auto session = session_mng_.Get(sessionid);
+		if (session != NULL)
+		{
+			return session->Send(buffer);
+		}
+
+		return SendResult::kSendNotConnected;
+	}
+
+	//io线程的CPU亲和性,见IoServicePool::SetCpuAffinity/SetAutoCpuAffinity,在Start之前调用
+	void SetCpuAffinity(std::vector<std::vector<uint32_t>> cpu_sets) { ios_pool_.SetCpuAffinity(std::move(cpu_sets)); }
+	void SetAutoCpuAffinity() { ios_pool_.SetAutoCpuAffinity(); }
+
+	//新连接的发送队列高低水位,见TcpSession::SetWriteWatermark
+	void SetWriteWatermark(size_t high, size_t low)
+	{
+		write_high_watermark_ = high;
+		write_low_watermark_ = low;
+	}
+
+	//新连接的写停滞超时(毫秒),发送队列非空但超时没有写出数据的连接以SessionError::kWriteStalled关闭,0表示不检查
+	void SetWriteStallTimeout(uint32_t milliseconds)
+	{
+		write_stall_timeout_milliseconds_ = milliseconds;
+	}
+
+	//新连接的接收缓冲区自适应策略,见RecvBufferPolicy,在Start之前调用
+	//所有session接收缓冲区的总上限用RecvBufferBudget::SetLimit设置
+	void SetRecvBufferPolicy(const RecvBufferPolicy& policy) { recv_buffer_policy_ = policy; }
+	const RecvBufferPolicy& GetRecvBufferPolicy() const { return recv_buffer_policy_; }
+
+	//新连接的接收超时检测方式,见IdlePolicy,在Start之前调用
+	void SetIdlePolicy(IdlePolicy policy) { idle_policy_ = policy; }
+	IdlePolicy GetIdlePolicy() const { return idle_policy_; }
+
+	//新连接的心跳,info只编码一次,所有session共享同一份payload,在Start之前调用
+	//每个io线程的心跳都由该线程的时间轮驱动,有数据写出的session只顺延不发送,见TcpSession::SetHeartbeat
+	void SetHeartbeat(std::string info, uint32_t heartbeat_intervals_seconds)
+	{
+		heartbeat_payload_ = SharedBuffer(std::move(info));
+		heartbeat_intervals_seconds_ = heartbeat_intervals_seconds;
+		rtt_probe_offset_ = RttProbe::kNone;
+	}
+
+	//新连接使用RTT心跳,见TcpSession::SetRttHeartbeat,在Start之前调用
+	//所有session的RTT采样汇总到GetRttHistogram
+	void SetRttHeartbeat(std::string payload, uint32_t probe_offset, uint32_t heartbeat_intervals_seconds)
+	{
+		if ((uint64_t)probe_offset + RttProbe::kSize > payload.size())
+			throw std::invalid_argument("SetRttHeartbeat exception:probe exceeds payload size");
+
+		heartbeat_payload_ = SharedBuffer(std::move(payload));
+		heartbeat_intervals_seconds_ = heartbeat_intervals_seconds;
+		rtt_probe_offset_ = probe_offset;
 	}
 
-#ifdef 	  SOCKET_HEADER_BODY_MODE
-	virtual uint32_t OnGetHeaderLength() = 0;
-	virtual int32_t OnGetBodyLength(std::shared_ptr<TSession> spsession session_ptr, std::vector<uint8_t>& header) = 0;
-	virtual int32_t OnMessage(std::shared_ptr<TSession> spsession, std::vector<uint8_t>& header, std::vector<uint8_t>& body) = 0;
-#else
-	virtual uint32_t OnRecv(std::shared_ptr<TSession> spsession, DataBuffer& recv_data) = 0;
-#endif // 
+	LatencyHistogram& GetRttHistogram() { return rtt_histogram_; }
+
+	//按io线程分组批量发送,同一份payload被所有目标session共享
+	size_t Broadcast(const SharedBuffer& payload)
+	{
+		return session_mng_.Broadcast(payload);
+	}
+
+	size_t Multicast(const std::vector<uint64_t>& sessionids, const SharedBuffer& payload)
+	{
+		return session_mng_.Multicast(sessionids, payload);
+	}
+
+	template <typename Predicate>
+	size_t Multicast(Predicate predicate, const SharedBuffer& payload)
+	{
+		return session_mng_.Multicast(predicate, payload);
+	}
+
+	//分包回调OnRecv/OnGetHeaderLength/OnGetBodyLength/OnMessage见FrameHandler,TSession的Framer用到的必须重写
+
+	//新连接使用的分包配置,每个session拷贝一份
+	Framer& GetFramer()
+	{
+		return framer_;
+	}
 
 	virtual void OnAcceptFailed(boost::system::error_code const& ec)
 	{
@@ -77,14 +164,35 @@ public:
 		session_mng_.Remove(spsession->GetSessionID());
 	};
 
+	virtual void OnWriteBlocked(std::shared_ptr<TSession> spsession, size_t queued_bytes)
+	{
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,SessionID:%llu,QueuedBytes:%zu\n", __FILE__, __FUNCTION__, __LINE__, (unsigned long long)spsession->GetSessionID(), queued_bytes);
+	}
+
+	virtual void OnWriteDrained(std::shared_ptr<TSession> spsession, size_t queued_bytes)
+	{
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,SessionID:%llu,QueuedBytes:%zu\n", __FILE__, __FUNCTION__, __LINE__, (unsigned long long)spsession->GetSessionID(), queued_bytes);
+	}
+
 protected:
 	void DoAccept();
+	void StartSession(boost::asio::io_service& ios, uint64_t sessionid, std::shared_ptr<boost::asio::ip::tcp::socket> peer);
 	SessionManager<TSession> session_mng_;
 private:
 	IoServicePool				ios_pool_;
 	boost::asio::ip::tcp::acceptor	acceptor_;
 	uint64_t id_;
 	bool is_running_;
+	std::atomic<size_t> write_high_watermark_;
+	std::atomic<size_t> write_low_watermark_;
+	std::atomic<uint32_t> write_stall_timeout_milliseconds_;
+	Framer framer_;
+	RecvBufferPolicy recv_buffer_policy_;
+	IdlePolicy idle_policy_;
+	SharedBuffer heartbeat_payload_;
+	uint32_t heartbeat_intervals_seconds_;
+	uint32_t rtt_probe_offset_;
+	LatencyHistogram rtt_histogram_;
 };
 
 #include <functional>
@@ -98,26 +206,16 @@ TcpServer<TSession>::~TcpServer()
 template <typename TSession>
 void TcpServer<TSession >::DoAccept()
 {
-	auto new_session = std::make_shared<TSession>(ios_pool_.GetIoService(), ++id_);
+	//连接直接接受到目标io_service的socket上,session交给该io线程创建
+	boost::asio::io_service& ios = ios_pool_.GetIoService();
+	auto peer = std::make_shared<boost::asio::ip::tcp::socket>(ios);
 
-
-	acceptor_.async_accept(new_session->GetSocket(),
-		[this, new_session](boost::system::error_code const& error)
+	acceptor_.async_accept(*peer,
+		[this, &ios, peer](boost::system::error_code const& error)
 	{
 		if (!error)
 		{
-			session_mng_.Insert(new_session);
-
-#ifdef 	   SOCKET_HEADER_BODY_MODE
-			new_session->SetMessageLengthCallback(std::bind(&TcpServer::OnGetHeaderLength, this), std::bind(&TcpServer::OnGetBodyLength, this, std::placeholders::_1));
-			new_session->SetMessageCallback(std::bind(&TcpServer::OnMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-#else
-			new_session->SetRecvCallback(std::bind(&TcpServer::OnRecv, this, std::placeholders::_1, std::placeholders::_2));
-#endif 
-			new_session->SetConnectCallback(std::bind(&TcpServer::OnConnect, this, std::placeholders::_1));
-			new_session->SetCloseCallback(std::bind(&TcpServer::OnClose, this, std::placeholders::_1, std::placeholders::_2));
-
-			new_session->Start();
+			ios.post(std::bind(&TcpServer::StartSession, this, std::ref(ios), ++id_, peer));
 		}
 		else
 		{
@@ -127,4 +225,30 @@ void TcpServer<TSession >::DoAccept()
 
 		DoAccept();
 	});
-}
\ No newline at end of file
+}
+
+//在session所属的io线程里执行:session对象、接收缓冲区和它用到的时间轮/空闲扫描都由这个线程创建,
+//绑定CPU时分配在本地NUMA节点上,也不会和工作线程初始化时的use_service同时创建服务
+template <typename TSession>
+void TcpServer<TSession >::StartSession(boost::asio::io_service& ios, uint64_t sessionid, std::shared_ptr<boost::asio::ip::tcp::socket> peer)
+{
+	auto new_session = std::make_shared<TSession>(ios, sessionid);
+	new_session->GetSocket() = std::move(*peer);
+
+	session_mng_.Insert(new_session);
+
+	new_session->SetFramer(framer_);
+	new_session->SetFrameHandler(this);
+	new_session->SetConnectCallback(std::bind(&TcpServer::OnConnect, this, std::placeholders::_1));
+	new_session->SetCloseCallback(std::bind(&TcpServer::OnClose, this, std::placeholders::_1, std::placeholders::_2));
+	new_session->SetWriteWatermarkCallback(std::bind(&TcpServer::OnWriteBlocked, this, std::placeholders::_1, std::placeholders::_2),
+		std::bind(&TcpServer::OnWriteDrained, this, std::placeholders::_1, std::placeholders::_2));
+	new_session->SetWriteWatermark(write_high_watermark_, write_low_watermark_);
+	new_session->SetWriteStallTimeout(write_stall_timeout_milliseconds_);
+	new_session->SetRecvBufferPolicy(recv_buffer_policy_);
+	new_session->SetIdlePolicy(idle_policy_);
+	new_session->InitHeartbeat(heartbeat_payload_, heartbeat_intervals_seconds_, rtt_probe_offset_);
+	new_session->SetRttHistogram(&rtt_histogram_);
+
+	new_session->Start();
+}
@@ -2,7 +2,8 @@
 #include <memory>
 #include <stdint.h>
 #include <string>
-#include <mutex>
+#include <vector>
+#include <algorithm>
 #include <atomic>
 
 #include "boost/noncopyable.hpp"
@@ -11,6 +12,15 @@
 #include "boost/asio/steady_timer.hpp"
 #include "boost/chrono.hpp"
 #include "tcpsessioncallback.h"
+#include "recvbufferpolicy.hpp"
+#include "recvbufferpool.hpp"
+#include "sendqueue.hpp"
+#include "sessionerror.hpp"
+#include "timingwheel.hpp"
+#include "idlesweeper.hpp"
+#include "rttestimator.hpp"
+#include "framer.hpp"
+#include "buffer/chainbuffer.hpp"
 
 template <typename TSession>
 class SessionManager;
@@ -22,33 +32,120 @@ template <typename TSession>
 class TcpClient;
 
 
-template <typename TSession>
+//Send的结果,可以像原来的bool返回值一样判断是否入队:if (session->Send(data))
+class SendResult
+{
+public:
+	enum Code :uint32_t
+	{
+		kSendSuccess = 0,
+		kSendHighWatermark,		//已入队,但发送队列超过了高水位,调用者应当限流或丢弃后续数据
+		kSendNotConnected		//未入队
+	};
+
+	SendResult(Code code) :code_(code) {}
+
+	//已入队(包括超过高水位)时为true
+	explicit operator bool() const { return code_ != kSendNotConnected; }
+
+	Code GetCode() const { return code_; }
+
+	friend bool operator==(SendResult a, SendResult b) { return a.code_ == b.code_; }
+	friend bool operator!=(SendResult a, SendResult b) { return a.code_ != b.code_; }
+
+private:
+	Code code_;
+};
+
+//Framer决定分包方式(见framer.hpp),不同Framer的session可以在同一个进程里共存
+template <typename TSession, typename Framer = RawFramer>
 class TcpSession : public std::enable_shared_from_this<TSession>, boost::noncopyable
 {
 public:
+	using FramerType = Framer;
+
 	TcpSession(boost::asio::io_service& ios, uint64_t sessionid, uint32_t check_recv_timeout_seconds = 0)
-		:ios_(ios), socket_(ios_), sessionid_(sessionid), check_connect_delay_and_connect_timeout_and_heartbeat_timer_(ios_), check_recv_timeout_timer_(ios_), recv_timeout_seconds_(check_recv_timeout_seconds)
-		, connect_delay_seconds_(0), heartbeat_intervals_seconds_(0), status_(SessionStatus::kInit)
+		:ios_(ios), timing_wheel_(boost::asio::use_service<TimingWheel>(ios)), idle_sweeper_(boost::asio::use_service<IdleSweeper>(ios)), socket_(ios_), sessionid_(sessionid), recv_timeout_seconds_(check_recv_timeout_seconds)
+		, connect_delay_seconds_(0), heartbeat_intervals_seconds_(0), rtt_probe_offset_(RttProbe::kNone), rtt_probe_seq_(0), rtt_acked_seq_(0), rtt_histogram_(nullptr)
+		, status_(SessionStatus::kInit)
+		, recv_read_size_(0), recv_small_reads_(0), recv_buffer_budget_(0), recv_buffer_borrowed_(false), header_size_(0), frame_handler_(nullptr), send_arena_used_(0), send_reserved_ptr_(nullptr), write_batch_count_(0), write_batch_bytes_(0)
+		, queued_bytes_(0), queued_messages_(0), high_watermark_(0), low_watermark_(0), write_blocked_(false), write_blocked_notified_(false)
+		, check_write_stall_timer_(ios_), write_stall_timeout_milliseconds_(0), write_stall_timer_armed_(false)
+		, idle_policy_(IdlePolicy::kTimer), last_read_milliseconds_(0)
 	{
+		write_buffers_.reserve(kMaxWriteBatchBuffers);
 
+		SetRecvBufferCapacity(recv_buffer_policy_.initial_size_);
 
-#ifdef SOCKET_HEADER_BODY_MODE
-
-#else
-		recv_buffer_.SetCapacitySize(kRecvBufferSize);
-#endif
+		check_recv_timeout_entry_.SetHandler([this]() { HandleRecvTimer(boost::system::error_code()); });
+		idle_sweep_entry_.SetHandler([this]() { HandleRecvTimer(boost::system::error_code()); });
 	}
 	virtual ~TcpSession();
 
 
 public:
 
-	bool Send(std::string data);
+	SendResult Send(std::string data);
+
+	//零拷贝发送,buffer可以同时发给多个session
+	SendResult Send(SharedBuffer buffer);
+
+	//拷贝一次[data,data+size)
+	SendResult Send(const void* data, size_t size);
+
+	//接管DataBuffer的可读部分,不拷贝数据
+	SendResult Send(DataBuffer&& data);
+
+	//接管ChainBuffer,每段作为一条消息连续入队(GetQueuedMessages按段计数),写时每段一个iovec,不拷贝数据
+	SendResult Send(ChainBuffer&& data);
+
+	//在session的发送区块里预留size字节,返回指向这块内存的DataBuffer(不拥有内存,写超过size会抛异常)
+	//应用直接在里面序列化(WriteIntegerBE/WritePod...),再调用CommitSend把[0,WritePos)入队,省去中间拷贝
+	//发送区块只追加不复用,已入队的部分由引用计数保证在写完之前有效
+	//同一个session的ReserveSend/CommitSend不能在多个线程里同时调用,通常在io线程(OnMessage等回调)里使用
+	DataBuffer ReserveSend(uint32_t size);
+	SendResult CommitSend(DataBuffer& reserved);
+
+	//发送队列字节数达到high时回调OnWriteBlocked,之后降到low以下时回调OnWriteDrained,high为0表示不限制
+	void SetWriteWatermark(size_t high, size_t low);
+
+	size_t GetQueuedBytes() const { return queued_bytes_.load(std::memory_order_relaxed); }
+	size_t GetQueuedMessages() const { return queued_messages_.load(std::memory_order_relaxed); }
+	bool IsWriteBlocked() const { return write_blocked_.load(std::memory_order_relaxed); }
+
+	//发送队列非空时,如果milliseconds内没有写出任何数据(部分写出也算),以SessionError::kWriteStalled关闭session,0表示不检查
+	void SetWriteStallTimeout(uint32_t milliseconds);
 
 	void SetRecvTimeOut(uint32_t check_recv_timeout_seconds);
 
+	//接收超时的检测方式,见IdlePolicy,只能在Start/Connect之前调用
+	void SetIdlePolicy(IdlePolicy policy) { idle_policy_ = policy; }
+	IdlePolicy GetIdlePolicy() const { return idle_policy_; }
+
+	//接收缓冲区自适应策略,只能在Start/Connect之前调用
+	void SetRecvBufferPolicy(const RecvBufferPolicy& policy);
+	uint32_t GetRecvBufferCapacity() { return recv_buffer_.GetCapacitySize(); }
+
+	//连接上之后调用,每check_heartbeat_timeout_seconds秒内没有写出过数据时发送一次strInfo,0表示不发送
+	//有数据写出时只顺延心跳(TimingWheel::Rearm),持续有流量的session不会触发心跳
 	void SetHeartbeat(std::string strInfo, uint32_t check_heartbeat_timeout_seconds = 0);
 
+	//payload可以被多个session共享,发送时不拷贝
+	void SetHeartbeat(SharedBuffer payload, uint32_t check_heartbeat_timeout_seconds = 0);
+
+	//RTT心跳:每heartbeat_intervals_seconds秒发送一次payload,发送时在[probe_offset,probe_offset+RttProbe::kSize)填入序号和发送时间
+	//对端需要原样回显这12字节,应用在OnMessage/OnRecv里识别出回显后调用OnRttEcho
+	//为了让有流量的session也有采样,RTT心跳不因为有数据写出而顺延
+	void SetRttHeartbeat(SharedBuffer payload, uint32_t probe_offset, uint32_t heartbeat_intervals_seconds);
+
+	//只能在io线程调用,probe指向回显的RttProbe;不是本session发出的、已经处理过或者更早的序号返回false
+	bool OnRttEcho(const uint8_t* probe);
+
+	//平滑RTT和抖动,没有采样时为0,可以在任意线程读取
+	std::chrono::microseconds GetSmoothedRtt() const { return std::chrono::microseconds(rtt_estimator_.GetSmoothedMicroseconds()); }
+	std::chrono::microseconds GetRttVariance() const { return std::chrono::microseconds(rtt_estimator_.GetVarianceMicroseconds()); }
+	uint64_t GetRttSamples() const { return rtt_estimator_.GetSamples(); }
+
 	void Shutdown(const boost::asio::socket_base::shutdown_type& what = boost::asio::ip::tcp::socket::shutdown_both, bool post = false);
 
 	bool IsConnect();
@@ -66,6 +163,7 @@ public:
 protected:
 	friend class TcpServer<TSession>;
 	friend class TcpClient<TSession>;
+	friend Framer;
 
 	bool Connect(const std::string &ip, unsigned short port, uint32_t delay_seconds = 0, uint32_t connect_timeout_seconds = 0);
 	bool Connect(boost::asio::ip::tcp::endpoint & connect_endpoint, uint32_t delay_seconds = 0, uint32_t connect_timeout_seconds = 0);
@@ -76,31 +174,55 @@ protected:
 
 	void SetConnectFailureCallback(ConnectFailureCallback<TSession> fnconnectfailure);
 
-#ifdef SOCKET_HEADER_BODY_MODE
 	void SetMessageLengthCallback(HeaderLengthCallback fnheaderlength, BodyLengthCallback<TSession> fnbodylength);
 	void SetMessageCallback(MessageCallback<TSession>  fnmessage);
-
-#else
 	void SetRecvCallback(RecvCallback<TSession> fnrecv);
-#endif // SOCKET_HEADER_BODY_MODE
+
+	//设置后数据回调直接交给handler,上面三个std::function回调不再使用;handler的生命期要长于session
+	void SetFrameHandler(FrameHandler<TSession, Framer>* handler);
+
+	void SetFramer(const Framer& framer) { framer_ = framer; }
+	Framer& GetFramer() { return framer_; }
 
 	void SetCloseCallback(CloseCallback<TSession> fnclose);
 
+	void SetWriteWatermarkCallback(WriteBlockedCallback<TSession> fnwriteblocked, WriteDrainedCallback<TSession> fnwritedrained);
+
+	//Start/Connect之前设置,连接上之后开始心跳
+	void InitHeartbeat(const SharedBuffer& payload, uint32_t heartbeat_intervals_seconds, uint32_t rtt_probe_offset = RttProbe::kNone)
+	{
+		heartbeat_payload_ = payload;
+		heartbeat_intervals_seconds_ = heartbeat_intervals_seconds;
+		rtt_probe_offset_ = rtt_probe_offset;
+	}
+
+	//每个RTT采样都记入histogram,histogram的生命周期要比session长
+	void SetRttHistogram(LatencyHistogram* histogram) { rtt_histogram_ = histogram; }
+
 
 protected:
 	void SetSocketNoDelay();
 
-	void DoSetHeartbeat(std::string strInfo, uint32_t check_heartbeat_timeout_seconds = 0);
+	void DoSetHeartbeat(SharedBuffer payload, uint32_t check_heartbeat_timeout_seconds = 0, uint32_t rtt_probe_offset = RttProbe::kNone);
+	void SendRttProbe();
 
 	void DoConnect(boost::asio::ip::tcp::endpoint & endpoint);
 	void HandleConnect(const boost::system::error_code & ec);
 
-	void HandleWrite(const boost::system::error_code & ec);
+	SendResult PushSendNode(SendNode* node);
+	SendResult PushSendNodes(SendNode* newest, SendNode* oldest, size_t count, size_t bytes);
+	void NotifyWriteBlocked();
+	void DoWrite();
+	void HandleWrite(const boost::system::error_code & ec, size_t bytes_transferred);
 
 	void ExpiresRecvTimer();
 	void CancelRecvTimer();
 	void HandleRecvTimer(boost::system::error_code const& error);
 
+	void ExpiresWriteStallTimer(std::chrono::steady_clock::duration expiry);
+	void CancelWriteStallTimer();
+	void HandleWriteStallTimer(boost::system::error_code const& ec);
+
 	void DoShutdown(const boost::asio::socket_base::shutdown_type& what = boost::asio::ip::tcp::socket::shutdown_both, const boost::system::error_code& ec = boost::asio::error::operation_aborted);
 
 	void ExpiresConnectDelayTimer();
@@ -111,15 +233,22 @@ protected:
 	void HandleConnectTimeoutTimer(boost::system::error_code const & ec);
 	void HandleHeartbeatTimer(boost::system::error_code const & ec);
 
-#ifdef SOCKET_HEADER_BODY_MODE
-	void ReadHeader();
-	void ReadBody();
-	void HandleReadHeader(const boost::system::error_code & ec);
-	void HandleReadBody(const boost::system::error_code & ec);
-#else
 	void ReadSome();
+	void DoReadSome();
 	void HandleReadSome(const boost::system::error_code & ec, std::size_t bytes_transferred);
-#endif // SOCKET_HEADER_BODY_MODE
+	void HandleReadable(const boost::system::error_code & ec);
+	void AdaptRecvBuffer(std::size_t bytes_transferred);
+	void SetRecvBufferCapacity(uint32_t size);
+	void SyncRecvBufferBudget();
+	void ReturnRecvBuffer();
+
+	//以下供Framer调用
+	bool DeliverRecv(DataBuffer& buffer);
+	void DeliverMessage(BufferView header, BufferView body);
+	uint32_t GetFrameHeaderSize() const { return header_size_; }
+	int32_t GetFrameBodyLength(BufferView header);
+	void ReserveRecvBuffer(uint32_t frame_size);
+	void CloseOnFrameError(const boost::system::error_code& ec);
 
 protected:
 	enum class SessionStatus :uint8_t
@@ -139,6 +268,8 @@ protected:
 	};
 private:
 	boost::asio::io_service& ios_;
+	TimingWheel& timing_wheel_;		//接收超时、心跳、连接延时/超时都挂在所属io_service的时间轮上
+	IdleSweeper& idle_sweeper_;		//IdlePolicy::kSweep时接收超时由所属io_service的IdleSweeper检查
 
 	boost::asio::ip::tcp::socket socket_;
 	uint64_t sessionid_;
@@ -147,11 +278,16 @@ private:
 	boost::asio::ip::tcp::endpoint local_endpoint_;
 	boost::asio::ip::tcp::endpoint remote_endpoint_;
 
-	boost::asio::steady_timer	check_connect_delay_and_connect_timeout_and_heartbeat_timer_;
+	TimingWheel::Entry	check_connect_delay_and_connect_timeout_and_heartbeat_entry_;
 	std::atomic<uint32_t>		connect_delay_seconds_;
 	std::atomic<uint32_t>       connect_timeout_seconds_;
 	std::atomic<uint32_t>		heartbeat_intervals_seconds_;
-	std::string  send_heartbeat_info_;
+	SharedBuffer  heartbeat_payload_;	//预先编码好的心跳,所有心跳共用一份
+	uint32_t rtt_probe_offset_;		//RTT心跳时RttProbe在payload里的位置,RttProbe::kNone表示普通心跳
+	uint32_t rtt_probe_seq_;		//最后发出的探测序号
+	uint32_t rtt_acked_seq_;		//最后处理的回显序号
+	RttEstimator rtt_estimator_;
+	LatencyHistogram* rtt_histogram_;
 
 	std::atomic<SessionStatus>  status_;
 
@@ -160,24 +296,53 @@ private:
 	ConnectFailureCallback<TSession> fnconnectfailure_;
 	ConnectCallback<TSession>  fnconnect_;
 
-#ifdef SOCKET_HEADER_BODY_MODE
-	std::vector<uint8_t> header_;
+	DataBuffer  recv_buffer_;
+	RecvBufferPolicy recv_buffer_policy_;
+	uint32_t recv_read_size_;		//本次async_read_some提供的空间
+	uint32_t recv_small_reads_;		//连续小读次数
+	uint32_t recv_buffer_budget_;	//已计入RecvBufferBudget的字节数
+	bool recv_buffer_borrowed_;		//recv_buffer_是从RecvBufferPool借来的,只有借来的才还给池
+	Framer framer_;
 	uint32_t header_size_;
-	std::vector<uint8_t> body_;
+	FrameHandler<TSession, Framer>* frame_handler_;
 	BodyLengthCallback<TSession> fnbodylength_;
 	MessageCallback<TSession>  fnmessage_;
-#else
-	DataBuffer  recv_buffer_;
 	RecvCallback<TSession>   fnrecv_;
-#endif // SOCKET_HEADER_BODY_MODE
-
-	std::deque<std::string> deq_messages_;
-	std::mutex send_mtx_;
-
 
-	boost::asio::steady_timer	check_recv_timeout_timer_;
+	SendQueue send_queue_;
+	SharedBuffer send_arena_;
+	size_t send_arena_used_;
+	const uint8_t* send_reserved_ptr_;	//最近一次ReserveSend的起始地址
+	SharedBuffer send_reserved_owner_;	//最近一次ReserveSend所在的内存
+	std::vector<boost::asio::const_buffer> write_buffers_;
+	size_t write_batch_count_;
+	size_t write_batch_bytes_;
+
+	//发送队列统计,生产者增加,io线程写完后减少
+	std::atomic<size_t> queued_bytes_;
+	std::atomic<size_t> queued_messages_;
+	std::atomic<size_t> high_watermark_;
+	std::atomic<size_t> low_watermark_;
+	std::atomic<bool> write_blocked_;
+	bool write_blocked_notified_;	//只在io线程访问,保证Blocked/Drained成对回调
+	WriteBlockedCallback<TSession> fnwriteblocked_;
+	WriteDrainedCallback<TSession> fnwritedrained_;
+
+	//写停滞检测:定时器只在写操作开始时启动,到期时根据最后一次写出数据(包括部分写出)的时间决定关闭还是顺延,不在每次写时重设
+	boost::asio::steady_timer	check_write_stall_timer_;
+	std::atomic<uint32_t>		write_stall_timeout_milliseconds_;
+	std::chrono::steady_clock::time_point last_write_progress_;
+	bool write_stall_timer_armed_;
+
+
+	TimingWheel::Entry	check_recv_timeout_entry_;
 	std::atomic<uint32_t>		recv_timeout_seconds_;
 
+	IdlePolicy idle_policy_;
+	IdleSweeper::Entry	idle_sweep_entry_;
+	//最后一次读完成的时间(TimingWheel::GetCoarseMilliseconds),只在io线程访问
+	uint64_t last_read_milliseconds_;
+
 	CloseCallback<TSession> fnclose_;
 };
 
@@ -187,40 +352,32 @@ private:
 
 
 
-template <typename TSession>
-void TcpSession<TSession>::HandleHeartbeatTimer(boost::system::error_code const & ec)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::HandleHeartbeatTimer(boost::system::error_code const & ec)
 {
 	//if (ec == boost::asio::error::operation_aborted) /*重设/取消 */
 	//{
 	//	return;
 	//}
 
-	printf("FILE:%s,FUNCTION:%s,LINE:%d, %d,%s\n", __FILE__, __FUNCTION__, __LINE__, ec.value(), boost::system::system_error(ec).what());
-
 	if (!ec)//0 操作成功
 	{
-		if (1)
+		if (rtt_probe_offset_ != RttProbe::kNone)
 		{
-			std::unique_lock<std::mutex>  lc(send_mtx_);
-
-			if (deq_messages_.empty())
-			{
-
-				deq_messages_.push_back(send_heartbeat_info_);
-
-				boost::asio::async_write(socket_,
-					boost::asio::buffer(deq_messages_.front()),
-					boost::bind(&TcpSession::HandleWrite, std::enable_shared_from_this<TSession>::shared_from_this(), boost::asio::placeholders::error));
-
-			}
+			SendRttProbe();
+		}
+		//每次写完都会顺延心跳,到期说明一个间隔内没有写出数据;队列里还有没写出的数据时同样不需要心跳
+		else if (send_queue_.IsIdle())
+		{
+			Send(heartbeat_payload_);
 		}
 
 		ExpiresHeartbeatTimer();
 	}
 }
 
-template <typename TSession>
-void TcpSession<TSession>::HandleConnectDelayTimer(boost::system::error_code const & ec)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::HandleConnectDelayTimer(boost::system::error_code const & ec)
 {
 	//if (ec == boost::asio::error::operation_aborted) /*重设/取消 */
 	//{
@@ -238,8 +395,8 @@ void TcpSession<TSession>::HandleConnectDelayTimer(boost::system::error_code con
 
 
 
-template <typename TSession>
-void TcpSession<TSession>::HandleConnectTimeoutTimer(boost::system::error_code const & ec)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::HandleConnectTimeoutTimer(boost::system::error_code const & ec)
 {
 	printf("FILE:%s,FUNCTION:%s,LINE:%d,%d,%s\n", __FILE__, __FUNCTION__, __LINE__, ec.value(), boost::system::system_error(ec).what());
 
@@ -250,18 +407,18 @@ void TcpSession<TSession>::HandleConnectTimeoutTimer(boost::system::error_code c
 	}
 }
 
-template <typename TSession>
-void TcpSession<TSession>::CancelConnectDelayAndConnectTimeoutAndHeartbeatTimer()
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::CancelConnectDelayAndConnectTimeoutAndHeartbeatTimer()
 {
-	boost::system::error_code	ignored_ec;
-	size_t				size = check_connect_delay_and_connect_timeout_and_heartbeat_timer_.cancel(ignored_ec);
+	size_t size = check_connect_delay_and_connect_timeout_and_heartbeat_entry_.IsArmed() ? 1 : 0;
+	timing_wheel_.Cancel(check_connect_delay_and_connect_timeout_and_heartbeat_entry_);
 
-	printf("FILE:%s,FUNCTION:%s,LINE:%d, %d canceled,%d,%s\n", __FILE__, __FUNCTION__, __LINE__, size, ignored_ec.value(), boost::system::system_error(ignored_ec).what());
+	printf("FILE:%s,FUNCTION:%s,LINE:%d, %zu canceled\n", __FILE__, __FUNCTION__, __LINE__, size);
 
 }
 
-template <typename TSession>
-void TcpSession<TSession>::ExpiresHeartbeatTimer()
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::ExpiresHeartbeatTimer()
 {
 
 	if (IsConnect())
@@ -269,42 +426,40 @@ void TcpSession<TSession>::ExpiresHeartbeatTimer()
 		if (heartbeat_intervals_seconds_ == 0)
 			return;
 
-		printf("FILE:%s,FUNCTION:%s,LINE:%d,heartbeat_intervals_seconds_:%d\n", __FILE__, __FUNCTION__, __LINE__, heartbeat_intervals_seconds_.load());
-
-		check_connect_delay_and_connect_timeout_and_heartbeat_timer_.expires_from_now(std::chrono::seconds(heartbeat_intervals_seconds_));
-		check_connect_delay_and_connect_timeout_and_heartbeat_timer_.async_wait(boost::bind(&TcpSession::HandleHeartbeatTimer, this->shared_from_this(), boost::asio::placeholders::error));
+		check_connect_delay_and_connect_timeout_and_heartbeat_entry_.SetHandler([this]() { HandleHeartbeatTimer(boost::system::error_code()); });
+		timing_wheel_.Arm(check_connect_delay_and_connect_timeout_and_heartbeat_entry_, std::chrono::seconds(heartbeat_intervals_seconds_), this->shared_from_this());
 	}
 
 }
 
-template <typename TSession>
-void TcpSession<TSession>::ExpiresConnectDelayTimer()
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::ExpiresConnectDelayTimer()
 {
 	if (connect_delay_seconds_ == 0)
 		return;
 
 	printf("FILE:%s,FUNCTION:%s,LINE:%d,connect_delay_seconds_:%d\n", __FILE__, __FUNCTION__, __LINE__, connect_delay_seconds_.load());
 
-	check_connect_delay_and_connect_timeout_and_heartbeat_timer_.expires_from_now(std::chrono::seconds(connect_delay_seconds_));
-	check_connect_delay_and_connect_timeout_and_heartbeat_timer_.async_wait(boost::bind(&TcpSession::HandleConnectDelayTimer, this->shared_from_this(), boost::asio::placeholders::error));
+	check_connect_delay_and_connect_timeout_and_heartbeat_entry_.SetHandler([this]() { HandleConnectDelayTimer(boost::system::error_code()); });
+	timing_wheel_.Arm(check_connect_delay_and_connect_timeout_and_heartbeat_entry_, std::chrono::seconds(connect_delay_seconds_), this->shared_from_this());
 
 }
 
-template <typename TSession>
-void TcpSession<TSession>::ExpiresConnectTimeoutTimer()
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::ExpiresConnectTimeoutTimer()
 {
 	if (connect_timeout_seconds_ == 0)
 		return;
 
 	printf("FILE:%s,FUNCTION:%s,LINE:%d,connect_timeout_seconds_:%d\n", __FILE__, __FUNCTION__, __LINE__, connect_timeout_seconds_.load());
 
-	check_connect_delay_and_connect_timeout_and_heartbeat_timer_.expires_from_now(std::chrono::seconds(connect_timeout_seconds_));
-	check_connect_delay_and_connect_timeout_and_heartbeat_timer_.async_wait(boost::bind(&TcpSession::HandleConnectTimeoutTimer, this->shared_from_this(), boost::asio::placeholders::error));
+	check_connect_delay_and_connect_timeout_and_heartbeat_entry_.SetHandler([this]() { HandleConnectTimeoutTimer(boost::system::error_code()); });
+	timing_wheel_.Arm(check_connect_delay_and_connect_timeout_and_heartbeat_entry_, std::chrono::seconds(connect_timeout_seconds_), this->shared_from_this());
 }
 
 
-template <typename TSession>
-void TcpSession<TSession>::HandleConnect(const boost::system::error_code & ec)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::HandleConnect(const boost::system::error_code & ec)
 {
 	if (!ec)
 	{
@@ -318,16 +473,16 @@ void TcpSession<TSession>::HandleConnect(const boost::system::error_code & ec)
 	}
 }
 
-template <typename TSession>
-void TcpSession<TSession>::SetSocketNoDelay()
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetSocketNoDelay()
 {
 	boost::asio::ip::tcp::no_delay option(true);
 	boost::system::error_code ec;
 	socket_.set_option(option, ec);
 }
 
-template <typename TSession>
-bool TcpSession<TSession>::Connect(boost::asio::ip::tcp::endpoint & connect_endpoint, uint32_t delay_seconds /*= 0*/, uint32_t connect_timeout_seconds /*= 0*/)
+template <typename TSession, typename Framer>
+bool TcpSession<TSession, Framer>::Connect(boost::asio::ip::tcp::endpoint & connect_endpoint, uint32_t delay_seconds /*= 0*/, uint32_t connect_timeout_seconds /*= 0*/)
 {
 	status_ = SessionStatus::kConnecting;
 
@@ -363,16 +518,16 @@ bool TcpSession<TSession>::Connect(boost::asio::ip::tcp::endpoint & connect_endp
 	return true;
 }
 
-template <typename TSession>
-bool TcpSession<TSession>::Connect(const std::string &ip, unsigned short port, uint32_t delay_seconds /*= 0*/, uint32_t connect_timeout_seconds /*= 0*/)
+template <typename TSession, typename Framer>
+bool TcpSession<TSession, Framer>::Connect(const std::string &ip, unsigned short port, uint32_t delay_seconds /*= 0*/, uint32_t connect_timeout_seconds /*= 0*/)
 {
 	boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string(ip), port);
 
 	return Connect(endpoint, delay_seconds, connect_timeout_seconds);
 }
 
-template <typename TSession>
-void TcpSession<TSession>::DoConnect(boost::asio::ip::tcp::endpoint & connect_endpoint)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::DoConnect(boost::asio::ip::tcp::endpoint & connect_endpoint)
 {
 	printf("FILE:%s,FUNCTION:%s,LINE:%d,%s:%d\n", __FILE__, __FUNCTION__, __LINE__, connect_endpoint.address().to_string().c_str(), connect_endpoint.port());
 
@@ -385,14 +540,14 @@ void TcpSession<TSession>::DoConnect(boost::asio::ip::tcp::endpoint & connect_en
 
 }
 
-template <typename TSession>
-bool TcpSession<TSession>::IsConnect()
+template <typename TSession, typename Framer>
+bool TcpSession<TSession, Framer>::IsConnect()
 {
 	return (status_ == SessionStatus::kRunning);
 }
 
-template <typename TSession>
-void TcpSession<TSession>::Shutdown(const boost::asio::socket_base::shutdown_type& what, bool post)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::Shutdown(const boost::asio::socket_base::shutdown_type& what, bool post)
 {
 	if (post)
 	{
@@ -404,13 +559,16 @@ void TcpSession<TSession>::Shutdown(const boost::asio::socket_base::shutdown_typ
 	}
 }
 
-template <typename TSession>
-void TcpSession<TSession>::DoSetHeartbeat(std::string strInfo, uint32_t heartbeat_intervals_seconds /*= 0*/)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::DoSetHeartbeat(SharedBuffer payload, uint32_t heartbeat_intervals_seconds /*= 0*/, uint32_t rtt_probe_offset /*= RttProbe::kNone*/)
 {
 	if (IsConnect())
 	{
-		send_heartbeat_info_ = std::move(strInfo);
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,heartbeat_intervals_seconds_:%d\n", __FILE__, __FUNCTION__, __LINE__, heartbeat_intervals_seconds);
+
+		heartbeat_payload_ = std::move(payload);
 		heartbeat_intervals_seconds_ = heartbeat_intervals_seconds;
+		rtt_probe_offset_ = rtt_probe_offset;
 		if (heartbeat_intervals_seconds != 0)
 		{
 			ExpiresHeartbeatTimer();
@@ -422,14 +580,61 @@ void TcpSession<TSession>::DoSetHeartbeat(std::string strInfo, uint32_t heartbea
 	}
 }
 
-template <typename TSession>
-void TcpSession<TSession>::SetHeartbeat(std::string strInfo, uint32_t check_heartbeat_timeout_seconds /*= 0*/)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetHeartbeat(std::string strInfo, uint32_t check_heartbeat_timeout_seconds /*= 0*/)
 {
-	ios_.post(boost::bind(&TcpSession::DoSetHeartbeat, this->shared_from_this(), std::move(strInfo), check_heartbeat_timeout_seconds));
+	SetHeartbeat(SharedBuffer(std::move(strInfo)), check_heartbeat_timeout_seconds);
 }
 
-template <typename TSession>
-void TcpSession<TSession>::SetRecvTimeOut(uint32_t check_recv_timeout_seconds)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetHeartbeat(SharedBuffer payload, uint32_t check_heartbeat_timeout_seconds /*= 0*/)
+{
+	ios_.post(boost::bind(&TcpSession::DoSetHeartbeat, this->shared_from_this(), std::move(payload), check_heartbeat_timeout_seconds, (uint32_t)RttProbe::kNone));
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetRttHeartbeat(SharedBuffer payload, uint32_t probe_offset, uint32_t heartbeat_intervals_seconds)
+{
+	if ((uint64_t)probe_offset + RttProbe::kSize > payload.GetSize())
+		throw std::invalid_argument("SetRttHeartbeat exception:probe exceeds payload size");
+
+	ios_.post(boost::bind(&TcpSession::DoSetHeartbeat, this->shared_from_this(), std::move(payload), heartbeat_intervals_seconds, probe_offset));
+}
+
+//每次探测拷贝一份payload再填入序号和时间,心跳间隔是秒级,这次拷贝可以忽略
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SendRttProbe()
+{
+	SharedBuffer probe(heartbeat_payload_.GetData(), heartbeat_payload_.GetSize());
+	RttProbe::Encode(const_cast<uint8_t*>(probe.GetData()) + rtt_probe_offset_, ++rtt_probe_seq_, RttProbe::NowMicroseconds());
+	Send(std::move(probe));
+}
+
+template <typename TSession, typename Framer>
+bool TcpSession<TSession, Framer>::OnRttEcho(const uint8_t* probe)
+{
+	uint32_t seq;
+	uint64_t send_microseconds;
+	RttProbe::Decode(probe, seq, send_microseconds);
+
+	//序号回绕时按差值比较,只接受(rtt_acked_seq_, rtt_probe_seq_]之间的序号
+	if ((int32_t)(seq - rtt_acked_seq_) <= 0 || (int32_t)(rtt_probe_seq_ - seq) < 0)
+		return false;
+
+	uint64_t now = RttProbe::NowMicroseconds();
+	if (send_microseconds > now)
+		return false;
+
+	rtt_acked_seq_ = seq;
+	rtt_estimator_.AddSample(now - send_microseconds);
+	if (rtt_histogram_ != nullptr)
+		rtt_histogram_->Record(now - send_microseconds);
+
+	return true;
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetRecvTimeOut(uint32_t check_recv_timeout_seconds)
 {
 	auto self(this->shared_from_this());
 
@@ -438,11 +643,8 @@ void TcpSession<TSession>::SetRecvTimeOut(uint32_t check_recv_timeout_seconds)
 		{
 			recv_timeout_seconds_ = check_recv_timeout_seconds;
 
-			if (recv_timeout_seconds_ == 0)
-			{
-				CancelRecvTimer();
-			}
-
+			//按新的超时重新登记
+			CancelRecvTimer();
 			ExpiresRecvTimer();
 		}
 	};
@@ -451,33 +653,181 @@ void TcpSession<TSession>::SetRecvTimeOut(uint32_t check_recv_timeout_seconds)
 
 }
 
-template <typename TSession>
-bool TcpSession<TSession>::Send(std::string data)
+template <typename TSession, typename Framer>
+SendResult TcpSession<TSession, Framer>::Send(std::string data)
 {
-	//ios_.post(boost::bind(&TcpSession::DoWrite, this->shared_from_this(), std::move(data)));
+	if (IsConnect())
+	{
+		return PushSendNode(new SendNode(std::move(data)));
+	}
 
-	std::unique_lock<std::mutex>  lc(send_mtx_);
+	return SendResult::kSendNotConnected;
+}
 
+template <typename TSession, typename Framer>
+SendResult TcpSession<TSession, Framer>::Send(SharedBuffer buffer)
+{
 	if (IsConnect())
 	{
-		bool write_in_progress = !deq_messages_.empty();
-		deq_messages_.push_back(std::move(data));
+		return PushSendNode(new SendNode(std::move(buffer)));
+	}
+
+	return SendResult::kSendNotConnected;
+}
+
+template <typename TSession, typename Framer>
+SendResult TcpSession<TSession, Framer>::Send(const void* data, size_t size)
+{
+	return Send(std::string(static_cast<const char*>(data), size));
+}
 
-		if (!write_in_progress)
+template <typename TSession, typename Framer>
+SendResult TcpSession<TSession, Framer>::Send(DataBuffer&& data)
+{
+	return Send(SharedBuffer(std::move(data)));
+}
+
+template <typename TSession, typename Framer>
+SendResult TcpSession<TSession, Framer>::Send(ChainBuffer&& data)
+{
+	if (!IsConnect())
+		return SendResult::kSendNotConnected;
+
+	if (data.Empty())
+		return SendResult::kSendSuccess;
+
+	//段的地址在ChainBuffer移动后不变,先取出各段再把整个ChainBuffer交给共享的holder
+	std::vector<BufferView> segments;
+	segments.reserve(data.GetSegmentCount());
+	for (auto segment : data.GetSegments())
+	{
+		segments.push_back(segment);
+	}
+
+	size_t bytes = (size_t)data.GetDataSize();
+	SharedBuffer owner = SharedBuffer::Hold(std::move(data));
+
+	//按newest->oldest串起来,一次CAS整体入队
+	SendNode* newest = nullptr;
+	SendNode* oldest = nullptr;
+	for (auto& segment : segments)
+	{
+		SendNode* node = new SendNode(SharedBuffer(owner, segment.GetData(), segment.GetSize()));
+		node->next_ = newest;
+		newest = node;
+		if (oldest == nullptr)
+			oldest = node;
+	}
+
+	return PushSendNodes(newest, oldest, segments.size(), bytes);
+}
+
+template <typename TSession, typename Framer>
+DataBuffer TcpSession<TSession, Framer>::ReserveSend(uint32_t size)
+{
+	if (size > kSendArenaSize)
+	{
+		//大消息单独分配,不占用发送区块
+		send_reserved_owner_ = SharedBuffer(nullptr, size);
+		send_reserved_ptr_ = send_reserved_owner_.GetData();
+	}
+	else
+	{
+		if (send_arena_.Empty() || send_arena_used_ + size > send_arena_.GetSize())
 		{
-			boost::asio::async_write(socket_,
-				boost::asio::buffer(deq_messages_.front()),
-				boost::bind(&TcpSession::HandleWrite, std::enable_shared_from_this<TSession>::shared_from_this(), boost::asio::placeholders::error));
+			//旧区块还被队列里的消息引用时,由最后一个引用释放
+			send_arena_ = SharedBuffer(nullptr, kSendArenaSize);
+			send_arena_used_ = 0;
 		}
 
-		return true;
+		send_reserved_owner_ = send_arena_;
+		send_reserved_ptr_ = send_arena_.GetData() + send_arena_used_;
 	}
 
-	return false;
+	return DataBuffer(const_cast<uint8_t*>(send_reserved_ptr_), size, false, false);
 }
 
-template <typename TSession>
-void TcpSession<TSession>::SetCloseCallback(CloseCallback<TSession> fnclose)
+template <typename TSession, typename Framer>
+SendResult TcpSession<TSession, Framer>::CommitSend(DataBuffer& reserved)
+{
+	const uint8_t* data = reserved.GetReadPtr() - reserved.GetReadPos();
+	if (send_reserved_ptr_ == nullptr || data != send_reserved_ptr_)
+		throw std::runtime_error("CommitSend exception:buffer was not returned by the last ReserveSend");
+
+	uint32_t size = reserved.GetWritePos();
+	SharedBuffer owner(std::move(send_reserved_owner_));
+	send_reserved_ptr_ = nullptr;
+
+	if (owner.GetData() == send_arena_.GetData() && !send_arena_.Empty())
+		send_arena_used_ += size;
+
+	if (size == 0)
+		return IsConnect() ? SendResult::kSendSuccess : SendResult::kSendNotConnected;
+
+	return Send(owner.Slice(data - owner.GetData(), size));
+}
+
+template <typename TSession, typename Framer>
+SendResult TcpSession<TSession, Framer>::PushSendNode(SendNode* node)
+{
+	return PushSendNodes(node, node, 1, node->GetSize());
+}
+
+template <typename TSession, typename Framer>
+SendResult TcpSession<TSession, Framer>::PushSendNodes(SendNode* newest, SendNode* oldest, size_t count, size_t bytes)
+{
+	size_t queued_bytes = queued_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	queued_messages_.fetch_add(count, std::memory_order_relaxed);
+
+	//队列原本空闲时由本次入队的线程负责启动写操作,写操作总是在session的io线程上进行
+	if (send_queue_.Push(newest, oldest))
+	{
+		ios_.dispatch(boost::bind(&TcpSession::DoWrite, std::enable_shared_from_this<TSession>::shared_from_this()));
+	}
+
+	size_t high_watermark = high_watermark_.load(std::memory_order_relaxed);
+	if (high_watermark != 0 && queued_bytes >= high_watermark)
+	{
+		if (!write_blocked_.load(std::memory_order_relaxed) && !write_blocked_.exchange(true))
+		{
+			ios_.post(boost::bind(&TcpSession::NotifyWriteBlocked, std::enable_shared_from_this<TSession>::shared_from_this()));
+		}
+
+		return SendResult::kSendHighWatermark;
+	}
+
+	return SendResult::kSendSuccess;
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::NotifyWriteBlocked()
+{
+	//投递期间队列可能已经降到低水位以下
+	if (write_blocked_ && !write_blocked_notified_)
+	{
+		write_blocked_notified_ = true;
+
+		if (fnwriteblocked_ != nullptr)
+			fnwriteblocked_(std::enable_shared_from_this<TSession>::shared_from_this(), GetQueuedBytes());
+	}
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetWriteWatermark(size_t high, size_t low)
+{
+	high_watermark_ = high;
+	low_watermark_ = std::min(low, high);
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetWriteWatermarkCallback(WriteBlockedCallback<TSession> fnwriteblocked, WriteDrainedCallback<TSession> fnwritedrained)
+{
+	fnwriteblocked_ = std::move(fnwriteblocked);
+	fnwritedrained_ = std::move(fnwritedrained);
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetCloseCallback(CloseCallback<TSession> fnclose)
 {
 	fnclose_ = std::move(fnclose);
 }
@@ -486,30 +836,36 @@ void TcpSession<TSession>::SetCloseCallback(CloseCallback<TSession> fnclose)
 
 
 
-template <typename TSession>
-void TcpSession<TSession>::SetConnectFailureCallback(ConnectFailureCallback<TSession> fnconnectfailure)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetConnectFailureCallback(ConnectFailureCallback<TSession> fnconnectfailure)
 {
 	fnconnectfailure_ = std::move(fnconnectfailure);
 }
 
-template <typename TSession>
-void TcpSession<TSession>::SetConnectCallback(ConnectCallback<TSession> fnconnect)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetConnectCallback(ConnectCallback<TSession> fnconnect)
 {
 	fnconnect_ = std::move(fnconnect);
 }
 
-template <typename TSession>
-TcpSession<TSession>::~TcpSession()
+template <typename TSession, typename Framer>
+TcpSession<TSession, Framer>::~TcpSession()
 {
 	boost::system::error_code	ignored_ec;
 	socket_.close(ignored_ec);
 
+	//非池模式的缓冲区不是借来的,不能计入RecvBufferPool的借出数;RecvBufferBudget按实际计入的字节数释放
+	if (recv_buffer_borrowed_)
+		RecvBufferPool::Discard(recv_buffer_);
+	RecvBufferBudget::Release(recv_buffer_budget_);
+	recv_buffer_budget_ = 0;
+
 	printf("%s,%d,%d,%s\n", __FUNCTION__, __LINE__, ignored_ec.value(), boost::system::system_error(ignored_ec).what());
 
 }
 
-template <typename TSession>
-bool TcpSession<TSession>::Start()
+template <typename TSession, typename Framer>
+bool TcpSession<TSession, Framer>::Start()
 {
 
 	status_ = SessionStatus::kRunning;
@@ -522,8 +878,6 @@ bool TcpSession<TSession>::Start()
 
 		CancelConnectDelayAndConnectTimeoutAndHeartbeatTimer();
 
-		//std::unique_lock<decltype(send_mtx_)> lc(send_mtx_);
-		//deq_messages_.clear();
 	}
 	catch (std::exception& e)
 	{
@@ -546,13 +900,8 @@ bool TcpSession<TSession>::Start()
 					assert(self->fnconnect_ != nullptr);
 					self->fnconnect_(self);
 
-#ifdef SOCKET_HEADER_BODY_MODE
-					self->ReadHeader();
-					self->ExpiresHeartbeatTimer();
-#else
 					self->ReadSome();
 					self->ExpiresHeartbeatTimer();
-#endif
 
 			}
 		}
@@ -613,60 +962,101 @@ bool TcpSession<TSession>::Start()
 
 
 
-#ifdef SOCKET_HEADER_BODY_MODE
-
-template <typename TSession>
-void TcpSession<TSession>::SetMessageCallback(MessageCallback<TSession> fnmessage)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetMessageCallback(MessageCallback<TSession> fnmessage)
 {
 	fnmessage_ = std::move(fnmessage);
 }
 
-template <typename TSession>
-void TcpSession<TSession>::SetMessageLengthCallback(HeaderLengthCallback fnheaderlength, BodyLengthCallback<TSession> fnbodylength)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetMessageLengthCallback(HeaderLengthCallback fnheaderlength, BodyLengthCallback<TSession> fnbodylength)
 {
 	header_size_ = fnheaderlength();
 	fnbodylength_ = std::move(fnbodylength);
 }
 
-template <typename TSession>
-void TcpSession<TSession>::ReadHeader()
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetRecvCallback(RecvCallback<TSession> fnrecv)
 {
-	header_.resize(header_size_);
+	fnrecv_ = std::move(fnrecv);
+}
 
-	boost::asio::async_read(socket_, boost::asio::buffer(header_), boost::asio::transfer_at_least(header_size_),
-		boost::bind(&TcpSession::HandleReadHeader, this->shared_from_this(), boost::asio::placeholders::error));
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetFrameHandler(FrameHandler<TSession, Framer>* handler)
+{
+	frame_handler_ = handler;
+	if (Framer::kNeedBodyLengthCallback)
+		header_size_ = handler->OnGetHeaderLength();
+}
 
+template <typename TSession, typename Framer>
+bool TcpSession<TSession, Framer>::DeliverRecv(DataBuffer& buffer)
+{
+	uint32_t r;
+	if (frame_handler_ != nullptr)
+	{
+		r = frame_handler_->OnRecv(this->shared_from_this(), buffer);
+	}
+	else
+	{
+		assert(fnrecv_ != nullptr);
+		r = fnrecv_(this->shared_from_this(), buffer);
+	}
+	return r == (uint32_t)HandleResult::kHandleSuccess || r == (uint32_t)HandleResult::kHandleContinue;
+}
 
-	ExpiresRecvTimer();
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::DeliverMessage(BufferView header, BufferView body)
+{
+	if (frame_handler_ != nullptr)
+	{
+		frame_handler_->OnMessage(this->shared_from_this(), header, body);
+		return;
+	}
 
+	assert(fnmessage_);
+	fnmessage_(this->shared_from_this(), header, body);
 }
 
-template <typename TSession>
-void TcpSession<TSession>::ReadBody()
+template <typename TSession, typename Framer>
+int32_t TcpSession<TSession, Framer>::GetFrameBodyLength(BufferView header)
 {
-	boost::asio::async_read(socket_, boost::asio::buffer(body_), boost::asio::transfer_at_least(body_.size()),
-		boost::bind(&TcpSession::HandleReadBody, std::enable_shared_from_this<TSession>::shared_from_this(), boost::asio::placeholders::error));
+	if (frame_handler_ != nullptr)
+		return frame_handler_->OnGetBodyLength(this->shared_from_this(), header);
 
-	ExpiresRecvTimer();
+	assert(fnbodylength_ != nullptr);
+	return fnbodylength_(this->shared_from_this(), header);
+}
 
+//包比缓冲区大时扩容,保证整包能连续存放
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::ReserveRecvBuffer(uint32_t frame_size)
+{
+	if (frame_size > recv_buffer_.GetCapacitySize())
+	{
+		SetRecvBufferCapacity(frame_size);
+	}
 }
 
-template <typename TSession>
-void TcpSession<TSession>::HandleReadHeader(const boost::system::error_code & ec)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::CloseOnFrameError(const boost::system::error_code& ec)
+{
+	DoShutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+}
+
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::HandleReadSome(const boost::system::error_code & ec, std::size_t bytes_transferred)
 {
 	if (!ec)
 	{
-		assert(fnbodylength_ != nullptr);
+		last_read_milliseconds_ = timing_wheel_.GetCoarseMilliseconds();
 
-		int32_t size = fnbodylength_(std::enable_shared_from_this<TSession>::shared_from_this(), header_);
-		if (size >= 0)
-		{
-			body_.resize(size);
-			ReadBody();
-		}
-		else
+		recv_buffer_.SetWritePos(recv_buffer_.GetWritePos() + bytes_transferred);
+		if (framer_.Decode(*this, recv_buffer_))
 		{
-			DoShutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+			AdaptRecvBuffer(bytes_transferred);
+			ReadSome();
 		}
 	}
 	else
@@ -677,92 +1067,272 @@ void TcpSession<TSession>::HandleReadHeader(const boost::system::error_code & ec
 	}
 }
 
-template<typename TSession>
-void TcpSession<TSession>::HandleReadBody(const boost::system::error_code & ec)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::ReadSome()
+{
+	if (recv_buffer_policy_.pooled_ && recv_buffer_.GetDataSize() == 0)
+	{
+		//没有未处理的数据,归还缓冲区,等socket可读时再借
+		ReturnRecvBuffer();
+
+		RecvBufferPool::AddWaiting();
+		socket_.async_wait(boost::asio::ip::tcp::socket::wait_read,
+			boost::bind(&TcpSession::HandleReadable, this->shared_from_this(),
+				boost::asio::placeholders::error));
+
+		ExpiresRecvTimer();
+		return;
+	}
+
+	DoReadSome();
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::HandleReadable(const boost::system::error_code & ec)
 {
+	RecvBufferPool::RemoveWaiting();
 
 	if (!ec)
 	{
-		assert(fnmessage_);
-		fnmessage_(std::enable_shared_from_this<TSession>::shared_from_this(), header_, body_);
+		recv_buffer_ = RecvBufferPool::Borrow(recv_buffer_policy_.initial_size_, recv_buffer_policy_.ring_);
+		recv_buffer_borrowed_ = true;
+		SyncRecvBufferBudget();
 
-		ReadHeader();
+		//数据已经到达,async_read_some会先尝试直接读
+		DoReadSome();
 	}
 	else
 	{
-		//printf("%s,%d,%d,%s\n", __FUNCTION__, __LINE__, ec.value(), boost::system::system_error(ec).what());
 		DoShutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
 	}
 }
 
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::DoReadSome()
+{
+	recv_buffer_.Adjustment();
+	recv_read_size_ = recv_buffer_.GetAvailableSize();
 
-#else
-
+	socket_.async_read_some(boost::asio::buffer(recv_buffer_.GetWritePtr(), recv_buffer_.GetAvailableSize()),
+		boost::bind(&TcpSession::HandleReadSome, this->shared_from_this(),
+			boost::asio::placeholders::error,
+			boost::asio::placeholders::bytes_transferred));
 
-template <typename TSession>
-void TcpSession<TSession>::SetRecvCallback(RecvCallback<TSession> fnrecv)
-{
-	fnrecv_ = std::move(fnrecv);
+	ExpiresRecvTimer();
 }
 
-
-template <typename TSession>
-void TcpSession<TSession>::HandleReadSome(const boost::system::error_code & ec, std::size_t bytes_transferred)
+//在两次读之间调整接收缓冲区容量,读操作进行中缓冲区不能移动
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::AdaptRecvBuffer(std::size_t bytes_transferred)
 {
-	if (!ec)
+	uint32_t capacity = recv_buffer_.GetCapacitySize();
+
+	if (bytes_transferred >= recv_read_size_)
 	{
-		recv_buffer_.SetWritePos(recv_buffer_.GetWritePos() + bytes_transferred);
-		auto r = fnrecv_(this->shared_from_this(), recv_buffer_);
-		if (r == (uint32_t)HandleResult::kHandleSuccess || r == (uint32_t)HandleResult::kHandleContinue)
+		//读满了,socket里可能还有数据,扩容减少读的次数
+		recv_small_reads_ = 0;
+		if (capacity < recv_buffer_policy_.max_size_)
 		{
-			ReadSome();
+			uint32_t new_capacity = (uint32_t)std::min<uint64_t>((uint64_t)capacity * 2, recv_buffer_policy_.max_size_);
+			if (RecvBufferBudget::TryAcquire(new_capacity - capacity))
+			{
+				recv_buffer_budget_ += new_capacity - capacity;
+				SetRecvBufferCapacity(new_capacity);
+			}
+		}
+	}
+	else if (bytes_transferred < capacity / 4)
+	{
+		//池模式下缓冲区处理完就归还,不需要缩小
+		if (!recv_buffer_policy_.pooled_ && recv_buffer_policy_.shrink_after_small_reads_ != 0 && capacity > recv_buffer_policy_.min_size_
+			&& ++recv_small_reads_ >= recv_buffer_policy_.shrink_after_small_reads_ && recv_buffer_.GetDataSize() == 0)
+		{
+			//Framer为大包扩的容直接缩回max_size
+			uint32_t new_capacity = capacity > recv_buffer_policy_.max_size_ ? recv_buffer_policy_.max_size_ : capacity / 2;
+			SetRecvBufferCapacity(std::max(new_capacity, recv_buffer_policy_.min_size_));
+			recv_small_reads_ = 0;
 		}
 	}
 	else
 	{
-		//printf("%s,%d,%d,%s\n", __FUNCTION__, __LINE__, ec.value(), boost::system::system_error(ec).what());
-
-		DoShutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+		recv_small_reads_ = 0;
 	}
 }
 
-template <typename TSession>
-void TcpSession<TSession>::ReadSome()
+//改变容量并同步RecvBufferBudget,size不能小于未处理的数据
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetRecvBufferCapacity(uint32_t size)
 {
 	recv_buffer_.Adjustment();
+	recv_buffer_.SetCapacitySize(std::max(size, recv_buffer_.GetDataSize()));
 
-	socket_.async_read_some(boost::asio::buffer(recv_buffer_.GetWritePtr(), recv_buffer_.GetAvailableSize()),
-		boost::bind(&TcpSession::HandleReadSome, this->shared_from_this(),
-			boost::asio::placeholders::error,
-			boost::asio::placeholders::bytes_transferred));
+	SyncRecvBufferBudget();
+}
 
-	ExpiresRecvTimer();
+//只归还从池里借来的缓冲区,之后recv_buffer_为空
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::ReturnRecvBuffer()
+{
+	if (!recv_buffer_borrowed_)
+		return;
+
+	RecvBufferPool::Return(recv_buffer_);
+	recv_buffer_borrowed_ = false;
+	SyncRecvBufferBudget();
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SyncRecvBufferBudget()
+{
+	uint32_t capacity = recv_buffer_.GetCapacitySize();
+	if (capacity > recv_buffer_budget_)
+		RecvBufferBudget::Acquire(capacity - recv_buffer_budget_);
+	else
+		RecvBufferBudget::Release(recv_buffer_budget_ - capacity);
+	recv_buffer_budget_ = capacity;
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetRecvBufferPolicy(const RecvBufferPolicy& policy)
+{
+	recv_buffer_policy_ = policy;
+	recv_buffer_policy_.min_size_ = std::max<uint32_t>(recv_buffer_policy_.min_size_, 1);
+	recv_buffer_policy_.max_size_ = std::max(recv_buffer_policy_.max_size_, recv_buffer_policy_.min_size_);
+	recv_buffer_policy_.initial_size_ = std::min(std::max(recv_buffer_policy_.initial_size_, recv_buffer_policy_.min_size_), recv_buffer_policy_.max_size_);
+
+	recv_small_reads_ = 0;
+	ReturnRecvBuffer();
+	if (recv_buffer_policy_.pooled_)
+	{
+		//缓冲区在第一次可读时从池里借
+		recv_buffer_ = DataBuffer();
+		SyncRecvBufferBudget();
+		return;
+	}
+
+	if (recv_buffer_policy_.ring_ && !recv_buffer_.IsRing() && !recv_buffer_.EnableRing(recv_buffer_policy_.initial_size_))
+	{
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,SessionID:%llu,ring buffer is not supported, fall back to linear buffer\n", __FILE__, __FUNCTION__, __LINE__, (unsigned long long)sessionid_);
+	}
+	SetRecvBufferCapacity(recv_buffer_policy_.initial_size_);
 }
 
-#endif // SOCKET_HEADER_BODY_MODE
 
 
 
+//只在io线程调用,把队列里已有的消息合并成一次scatter/gather写(writev)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::DoWrite()
+{
+	if (!IsConnect())
+		return;
 
-template <typename TSession>
-void TcpSession<TSession>::HandleWrite(const boost::system::error_code & ec)
+	for (;;)
+	{
+		send_queue_.Collect();
+		if (!send_queue_.Empty())
+			break;
+
+		//没有待发送的消息,回到空闲状态,之后由下一个入队的生产者启动写操作
+		if (send_queue_.Release())
+			return;
+	}
+
+	write_buffers_.clear();
+
+	size_t batch_count = 0;
+	size_t batch_bytes = 0;
+	for (SendNode* node = send_queue_.Front(); node != nullptr; node = node->next_)
+	{
+		//单条超过上限的消息也要发出去,只是不再合并其它消息
+		if (batch_count != 0 && batch_bytes + node->GetSize() > kMaxWriteBatchBytes)
+			break;
+
+		//和上一段在内存上首尾相接(同一发送区块里连续CommitSend的消息)时合并成一个iovec
+		const uint8_t* data = static_cast<const uint8_t*>(node->GetData());
+		if (!write_buffers_.empty() && static_cast<const uint8_t*>(write_buffers_.back().data()) + write_buffers_.back().size() == data)
+		{
+			write_buffers_.back() = boost::asio::buffer(write_buffers_.back().data(), write_buffers_.back().size() + node->GetSize());
+		}
+		else
+		{
+			if (write_buffers_.size() >= kMaxWriteBatchBuffers)
+				break;
+
+			write_buffers_.push_back(boost::asio::buffer(data, node->GetSize()));
+		}
+
+		++batch_count;
+		batch_bytes += node->GetSize();
+	}
+
+	write_batch_count_ = batch_count;
+	write_batch_bytes_ = batch_bytes;
+
+	if (!write_stall_timer_armed_ && write_stall_timeout_milliseconds_ != 0)
+	{
+		last_write_progress_ = std::chrono::steady_clock::now();
+		ExpiresWriteStallTimer(std::chrono::milliseconds(write_stall_timeout_milliseconds_));
+	}
+
+	//直接用async_write_some,一次sendmsg最多带kMaxWriteBatchBuffers个iovec(async_write每次只准备16个)
+	socket_.async_write_some(write_buffers_,
+		boost::bind(&TcpSession::HandleWrite, std::enable_shared_from_this<TSession>::shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::HandleWrite(const boost::system::error_code & ec, size_t bytes_transferred)
 {
 
 	if (!ec)
 	{
-		std::unique_lock<std::mutex>  lc(send_mtx_);
-
+		//对端读得慢时一批数据要分多次写完,部分写出也算写有进展,推迟写停滞的判定
+		if (write_stall_timer_armed_)
+		{
+			last_write_progress_ = std::chrono::steady_clock::now();
+		}
 
-		deq_messages_.pop_front();
+		//去掉已经写完的iovec,剩下的继续写
+		size_t written = 0;
+		while (written < write_buffers_.size() && bytes_transferred >= write_buffers_[written].size())
+		{
+			bytes_transferred -= write_buffers_[written].size();
+			++written;
+		}
+		write_buffers_.erase(write_buffers_.begin(), write_buffers_.begin() + written);
+		if (!write_buffers_.empty())
+		{
+			write_buffers_.front() += bytes_transferred;
+			socket_.async_write_some(write_buffers_,
+				boost::bind(&TcpSession::HandleWrite, std::enable_shared_from_this<TSession>::shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+			return;
+		}
 
-		if (!deq_messages_.empty() && IsConnect())
+		//连接上之后这个Entry只用于心跳,写出了数据就顺延,只改到期时间
+		if (heartbeat_intervals_seconds_.load(std::memory_order_relaxed) != 0 && rtt_probe_offset_ == RttProbe::kNone)
 		{
-			boost::asio::async_write(socket_,
-				boost::asio::buffer(deq_messages_.front()),
-				boost::bind(&TcpSession::HandleWrite, std::enable_shared_from_this<TSession>::shared_from_this(), boost::asio::placeholders::error));
+			timing_wheel_.Rearm(check_connect_delay_and_connect_timeout_and_heartbeat_entry_, std::chrono::seconds(heartbeat_intervals_seconds_.load(std::memory_order_relaxed)));
 		}
 
+		send_queue_.PopFront(write_batch_count_);
+		queued_messages_.fetch_sub(write_batch_count_, std::memory_order_relaxed);
+		size_t queued_bytes = queued_bytes_.fetch_sub(write_batch_bytes_, std::memory_order_relaxed) - write_batch_bytes_;
+		write_batch_count_ = 0;
+		write_batch_bytes_ = 0;
+
+		if (write_blocked_.load(std::memory_order_relaxed) && queued_bytes <= low_watermark_.load(std::memory_order_relaxed))
+		{
+			write_blocked_ = false;
+			if (write_blocked_notified_)
+			{
+				write_blocked_notified_ = false;
+
+				if (fnwritedrained_ != nullptr)
+					fnwritedrained_(std::enable_shared_from_this<TSession>::shared_from_this(), queued_bytes);
+			}
+		}
 
+		DoWrite();
 
 	}
 	else
@@ -774,33 +1344,49 @@ void TcpSession<TSession>::HandleWrite(const boost::system::error_code & ec)
 	}
 }
 
-template <typename TSession>
-void TcpSession<TSession>::ExpiresRecvTimer()
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::ExpiresRecvTimer()
 {
 	if (IsConnect())
 	{
 		if (recv_timeout_seconds_ == 0)
 			return;
 
+		if (idle_policy_ == IdlePolicy::kSweep)
+		{
+			//读完成时已经记录了时间戳,这里只在第一次登记
+			if (idle_sweep_entry_.IsLinked())
+				return;
+
+			printf("FILE:%s,FUNCTION:%s,LINE:%d,check_recv_timeout_seconds_:%d\n", __FILE__, __FUNCTION__, __LINE__, recv_timeout_seconds_.load());
+
+			idle_sweeper_.Add(idle_sweep_entry_, &last_read_milliseconds_, std::chrono::seconds(recv_timeout_seconds_), this->shared_from_this());
+			return;
+		}
+
+		//每次读都会调用,已经挂上时只改到期时间
+		if (timing_wheel_.Rearm(check_recv_timeout_entry_, std::chrono::seconds(recv_timeout_seconds_)))
+			return;
+
 		printf("FILE:%s,FUNCTION:%s,LINE:%d,check_recv_timeout_seconds_:%d\n", __FILE__, __FUNCTION__, __LINE__, recv_timeout_seconds_.load());
 
-		check_recv_timeout_timer_.expires_from_now(std::chrono::seconds(recv_timeout_seconds_));
-		check_recv_timeout_timer_.async_wait(boost::bind(&TcpSession::HandleRecvTimer, this->shared_from_this(), boost::asio::placeholders::error));
+		timing_wheel_.Arm(check_recv_timeout_entry_, std::chrono::seconds(recv_timeout_seconds_), this->shared_from_this());
 	}
 
 }
 
-template <typename TSession>
-void TcpSession<TSession>::CancelRecvTimer()
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::CancelRecvTimer()
 {
-	boost::system::error_code	ignored_ec;
-	size_t				size = check_recv_timeout_timer_.cancel(ignored_ec);
+	size_t size = (check_recv_timeout_entry_.IsArmed() ? 1 : 0) + (idle_sweep_entry_.IsLinked() ? 1 : 0);
+	timing_wheel_.Cancel(check_recv_timeout_entry_);
+	idle_sweeper_.Remove(idle_sweep_entry_);
 
-	printf("FILE:%s,FUNCTION:%s,LINE:%d, %d canceled,%d,%s\n", __FILE__, __FUNCTION__, __LINE__, size, ignored_ec.value(), boost::system::system_error(ignored_ec).what());
+	printf("FILE:%s,FUNCTION:%s,LINE:%d, %zu canceled\n", __FILE__, __FUNCTION__, __LINE__, size);
 }
 
-template <typename TSession>
-void TcpSession<TSession>::HandleRecvTimer(boost::system::error_code const & ec)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::HandleRecvTimer(boost::system::error_code const & ec)
 {
 	//if (ec == boost::asio::error::operation_aborted) /*重设/取消 */
 	//{
@@ -819,17 +1405,68 @@ void TcpSession<TSession>::HandleRecvTimer(boost::system::error_code const & ec)
 	}
 }
 
-template <typename TSession>
-void TcpSession<TSession>::DoShutdown(const boost::asio::socket_base::shutdown_type& what, const boost::system::error_code& ec)
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::SetWriteStallTimeout(uint32_t milliseconds)
 {
-	std::unique_lock<std::mutex>  lc(send_mtx_);
+	write_stall_timeout_milliseconds_ = milliseconds;
+}
 
-	if (IsConnect())
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::ExpiresWriteStallTimer(std::chrono::steady_clock::duration expiry)
+{
+	write_stall_timer_armed_ = true;
+
+	check_write_stall_timer_.expires_from_now(expiry);
+	check_write_stall_timer_.async_wait(boost::bind(&TcpSession::HandleWriteStallTimer, this->shared_from_this(), boost::asio::placeholders::error));
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::CancelWriteStallTimer()
+{
+	boost::system::error_code	ignored_ec;
+	check_write_stall_timer_.cancel(ignored_ec);
+	write_stall_timer_armed_ = false;
+}
+
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::HandleWriteStallTimer(boost::system::error_code const & ec)
+{
+	if (ec || !IsConnect())
+		return;
+
+	write_stall_timer_armed_ = false;
+
+	//写操作已经结束,等下次写操作开始时再启动
+	if (write_batch_count_ == 0 || write_stall_timeout_milliseconds_ == 0)
+		return;
+
+	auto timeout = std::chrono::steady_clock::duration(std::chrono::milliseconds(write_stall_timeout_milliseconds_));
+	auto elapsed = std::chrono::steady_clock::now() - last_write_progress_;
+	if (elapsed < timeout)
 	{
-		status_ = SessionStatus::kShuttingdown;
+		ExpiresWriteStallTimer(timeout - elapsed);
+		return;
+	}
+
+	printf("FILE:%s,FUNCTION:%s,LINE:%d,SessionID:%llu,QueuedBytes:%zu\n", __FILE__, __FUNCTION__, __LINE__, (unsigned long long)sessionid_, GetQueuedBytes());
+
+	DoShutdown(boost::asio::ip::tcp::socket::shutdown_both, SessionError::kWriteStalled);
+
+	//对端不读数据时挂起的async_write不会自己完成,取消它以释放session
+	boost::system::error_code	ignored_ec;
+	socket_.cancel(ignored_ec);
+}
 
+template <typename TSession, typename Framer>
+void TcpSession<TSession, Framer>::DoShutdown(const boost::asio::socket_base::shutdown_type& what, const boost::system::error_code& ec)
+{
+	//状态切换保证只关闭一次,之后Send不再入队
+	SessionStatus running = SessionStatus::kRunning;
+	if (status_.compare_exchange_strong(running, SessionStatus::kShuttingdown))
+	{
 		CancelConnectDelayAndConnectTimeoutAndHeartbeatTimer();
 		CancelRecvTimer();
+		CancelWriteStallTimer();
 
 
 		boost::system::error_code	ignored_ec;
@@ -837,8 +1474,6 @@ void TcpSession<TSession>::DoShutdown(const boost::asio::socket_base::shutdown_t
 
 		//socket_.close(ignored_ec);
 
-		lc.unlock();
-
 		assert(fnclose_ != nullptr);
 		fnclose_(std::enable_shared_from_this<TSession>::shared_from_this(), ec);
 	}
@@ -5,9 +5,17 @@
 #include <vector>
 #include "boost/filesystem.hpp"
 #include "buffer/databuffer.hpp"
+#include "buffer/bufferview.hpp"
 
 const uint32_t kRecvBufferSize = 4096;
 
+//一次合并写(writev)最多携带的消息条数和字节数
+const uint32_t kMaxWriteBatchBuffers = 64;
+const uint32_t kMaxWriteBatchBytes = 256 * 1024;
+
+//ReserveSend使用的每个session的发送区块大小,超过的预留单独分配
+const uint32_t kSendArenaSize = 64 * 1024;
+
 template <typename TSession>
 using  TcpSessionPtr = std::shared_ptr<TSession>;
 
@@ -20,14 +28,113 @@ using  ConnectFailureCallback = std::function<void(TcpSessionPtr<TSession> sessi
 template <typename TSession>
 using CloseCallback = std::function<void(TcpSessionPtr<TSession> session_ptr, const boost::system::error_code& ec)>;
 
+template <typename TSession>
+using WriteBlockedCallback = std::function<void(TcpSessionPtr<TSession> session_ptr, size_t queued_bytes)>;
+
+template <typename TSession>
+using WriteDrainedCallback = std::function<void(TcpSessionPtr<TSession> session_ptr, size_t queued_bytes)>;
+
 template <typename TSession>
 using RecvCallback = std::function<uint32_t(TcpSessionPtr<TSession> session_ptr, DataBuffer& recv_data)>;
 
 using HeaderLengthCallback = std::function<uint32_t()>;
 
 template <typename TSession>
-using BodyLengthCallback = std::function<int32_t(TcpSessionPtr<TSession> session_ptr, std::vector<uint8_t>& header)>;
+using BodyLengthCallback = std::function<int32_t(TcpSessionPtr<TSession> session_ptr, BufferView header)>;
 
 template <typename TSession>
-using MessageCallback = std::function<int32_t(TcpSessionPtr<TSession> session_ptr, std::vector<uint8_t>& header, std::vector<uint8_t>& body)>;
+using MessageCallback = std::function<int32_t(TcpSessionPtr<TSession> session_ptr, BufferView header, BufferView body)>;
+
+//数据回调的接收者,TcpServer/TcpClient实现
+//session每个包直接调用它的虚函数,不经过std::bind和std::function
+//Framer用到的回调是纯虚函数,应用忘了重写时TcpServer/TcpClient的子类是抽象类,编译失败;
+//用不到的回调有默认实现,session不会调用,被调用时打印日志
+template <typename TSession, bool kNeeded>
+class RecvHandler
+{
+public:
+	virtual uint32_t OnRecv(TcpSessionPtr<TSession> session_ptr, DataBuffer& recv_data) = 0;
+
+protected:
+	~RecvHandler() {}
+};
+
+template <typename TSession>
+class RecvHandler<TSession, false>
+{
+public:
+	virtual uint32_t OnRecv(TcpSessionPtr<TSession> /*session_ptr*/, DataBuffer& /*recv_data*/)
+	{
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,OnRecv is not used by this Framer\n", __FILE__, __FUNCTION__, __LINE__);
+		return 3;//TcpSession::HandleResult::kHandleError
+	}
+
+protected:
+	~RecvHandler() {}
+};
+
+template <typename TSession, bool kNeeded>
+class BodyLengthHandler
+{
+public:
+	virtual uint32_t OnGetHeaderLength() = 0;
+	virtual int32_t OnGetBodyLength(TcpSessionPtr<TSession> session_ptr, BufferView header) = 0;
+
+protected:
+	~BodyLengthHandler() {}
+};
+
+template <typename TSession>
+class BodyLengthHandler<TSession, false>
+{
+public:
+	virtual uint32_t OnGetHeaderLength()
+	{
+		return 0;
+	}
+
+	virtual int32_t OnGetBodyLength(TcpSessionPtr<TSession> /*session_ptr*/, BufferView /*header*/)
+	{
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,OnGetBodyLength is not used by this Framer\n", __FILE__, __FUNCTION__, __LINE__);
+		return -1;
+	}
+
+protected:
+	~BodyLengthHandler() {}
+};
+
+template <typename TSession, bool kNeeded>
+class MessageHandler
+{
+public:
+	virtual int32_t OnMessage(TcpSessionPtr<TSession> session_ptr, BufferView header, BufferView body) = 0;
+
+protected:
+	~MessageHandler() {}
+};
+
+template <typename TSession>
+class MessageHandler<TSession, false>
+{
+public:
+	virtual int32_t OnMessage(TcpSessionPtr<TSession> /*session_ptr*/, BufferView /*header*/, BufferView /*body*/)
+	{
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,OnMessage is not used by this Framer\n", __FILE__, __FUNCTION__, __LINE__);
+		return 1;
+	}
+
+protected:
+	~MessageHandler() {}
+};
+
+//按Framer的kNeedRecvCallback/kNeedBodyLengthCallback/kNeedMessageCallback组合:
+//RawFramer要重写OnRecv,HeaderBodyFramer要重写OnGetHeaderLength/OnGetBodyLength/OnMessage,其它Framer要重写OnMessage
+template <typename TSession, typename Framer>
+class FrameHandler :public RecvHandler<TSession, Framer::kNeedRecvCallback>,
+	public BodyLengthHandler<TSession, Framer::kNeedBodyLengthCallback>,
+	public MessageHandler<TSession, Framer::kNeedMessageCallback>
+{
+protected:
+	~FrameHandler() {}
+};
 
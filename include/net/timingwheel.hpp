@@ -0,0 +1,306 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include "boost/noncopyable.hpp"
+#include "boost/asio.hpp"
+#include "boost/asio/steady_timer.hpp"
+
+//use_service按Service::id区分服务,模板的静态成员可以定义在头文件里
+template<typename Service>
+struct IoServiceId
+{
+	static boost::asio::io_service::id id;
+};
+
+template<typename Service>
+boost::asio::io_service::id IoServiceId<Service>::id;
+
+//分层时间轮,每个io_service一份(boost::asio::use_service<TimingWheel>(ios)),只能在该io_service的线程里使用
+//  4层,每层64个槽,精度kTickMilliseconds,最长约19天,更长的按最长处理
+//  Arm/Cancel只是双向链表的摘除和插入,O(1);延后已经挂上的Entry只改到期时间,槽到期时发现没到再挂到新位置
+//  所有Entry共用一个steady_timer按tick推进,没有Entry时停止
+//  Entry挂上期间持有owner(通常是session)的引用,到期或Cancel后释放,和async_wait的handler持有shared_from_this相同
+class TimingWheel : public boost::asio::io_service::service, public IoServiceId<TimingWheel>
+{
+public:
+	static const uint32_t kTickMilliseconds = 100;
+	static const uint32_t kSlotBits = 6;
+	static const uint32_t kSlots = 1 << kSlotBits;
+	static const uint32_t kLevels = 4;
+
+	class Entry : boost::noncopyable
+	{
+	public:
+		Entry() :prev_(nullptr), next_(nullptr), expire_tick_(0) {}
+
+		//到期时在io线程里调用,handler里可以重新Arm
+		void SetHandler(std::function<void()> handler) { handler_ = std::move(handler); }
+
+		bool IsArmed() const { return next_ != nullptr; }
+
+	private:
+		friend class TimingWheel;
+
+		Entry* prev_;
+		Entry* next_;
+		uint64_t expire_tick_;
+		std::shared_ptr<void> owner_;
+		std::function<void()> handler_;
+	};
+
+	explicit TimingWheel(boost::asio::io_service& ios)
+		:boost::asio::io_service::service(ios), timer_(ios), epoch_(std::chrono::steady_clock::now()), current_tick_(0), armed_count_(0), ticking_(false)
+	{
+		for (auto& slot : slots_)
+			InitList(slot);
+	}
+
+	~TimingWheel()
+	{
+		ReleaseAll();
+	}
+
+	//delay之后调用entry的handler,已经挂上时改为新的到期时间
+	template<typename Rep, typename Period>
+	void Arm(Entry& entry, std::chrono::duration<Rep, Period> delay, std::shared_ptr<void> owner)
+	{
+		if (Rearm(entry, delay))
+			return;
+
+		//停止期间current_tick_没有推进,先跳到当前时间再计算到期tick
+		if (!ticking_)
+			current_tick_ = NowTick();
+
+		entry.owner_ = std::move(owner);
+		entry.expire_tick_ = ToExpireTick(delay);
+		Insert(entry);
+		++armed_count_;
+
+		StartTicking();
+	}
+
+	//只对已经挂上的entry有效,返回false表示entry没有挂上,需要用Arm
+	template<typename Rep, typename Period>
+	bool Rearm(Entry& entry, std::chrono::duration<Rep, Period> delay)
+	{
+		if (!entry.IsArmed())
+			return false;
+
+		uint64_t expire_tick = ToExpireTick(delay);
+		if (expire_tick >= entry.expire_tick_)
+		{
+			//延后:原来的槽到期时再挂到新位置
+			entry.expire_tick_ = expire_tick;
+			return true;
+		}
+
+		Unlink(entry);
+		entry.expire_tick_ = expire_tick;
+		Insert(entry);
+		return true;
+	}
+
+	void Cancel(Entry& entry)
+	{
+		if (!entry.IsArmed())
+			return;
+
+		Unlink(entry);
+		--armed_count_;
+		entry.owner_.reset();
+	}
+
+	size_t GetArmedCount() const { return armed_count_; }
+
+	//粗粒度的单调时间(毫秒),精度kTickMilliseconds,推进期间不取系统时间,适合在数据路径上记录时间戳
+	uint64_t GetCoarseMilliseconds() const
+	{
+		return (ticking_ ? current_tick_ : NowTick()) * kTickMilliseconds;
+	}
+
+private:
+	void shutdown() override
+	{
+		boost::system::error_code ignored_ec;
+		timer_.cancel(ignored_ec);
+		ReleaseAll();
+	}
+
+	static void InitList(Entry& head)
+	{
+		head.prev_ = &head;
+		head.next_ = &head;
+	}
+
+	static void Unlink(Entry& entry)
+	{
+		entry.prev_->next_ = entry.next_;
+		entry.next_->prev_ = entry.prev_;
+		entry.prev_ = nullptr;
+		entry.next_ = nullptr;
+	}
+
+	static void PushBack(Entry& head, Entry& entry)
+	{
+		entry.prev_ = head.prev_;
+		entry.next_ = &head;
+		head.prev_->next_ = &entry;
+		head.prev_ = &entry;
+	}
+
+	uint64_t NowTick() const
+	{
+		return (uint64_t)(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_).count() / kTickMilliseconds);
+	}
+
+	//向上取整,至少下一个tick
+	template<typename Rep, typename Period>
+	uint64_t ToExpireTick(std::chrono::duration<Rep, Period> delay) const
+	{
+		int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(delay).count();
+		uint64_t ticks = ms <= 0 ? 1 : ((uint64_t)ms + kTickMilliseconds - 1) / kTickMilliseconds;
+
+		const uint64_t max_ticks = ((uint64_t)1 << (kSlotBits * kLevels)) - 1;
+		return current_tick_ + (ticks < max_ticks ? ticks : max_ticks);
+	}
+
+	//按离到期的tick数选层,第k层的槽按到期tick的第k组6位选
+	void Insert(Entry& entry)
+	{
+		uint64_t expire_tick = entry.expire_tick_ > current_tick_ ? entry.expire_tick_ : current_tick_;
+		uint64_t delta = expire_tick - current_tick_;
+
+		uint32_t level = 0;
+		while (level + 1 < kLevels && delta >= ((uint64_t)1 << (kSlotBits * (level + 1))))
+			++level;
+
+		uint32_t index = (uint32_t)((expire_tick >> (kSlotBits * level)) & (kSlots - 1));
+		PushBack(slots_[level * kSlots + index], entry);
+	}
+
+	void StartTicking()
+	{
+		if (ticking_)
+			return;
+
+		ticking_ = true;
+		ExpiresTick();
+	}
+
+	void ExpiresTick()
+	{
+		timer_.expires_at(epoch_ + std::chrono::milliseconds((current_tick_ + 1) * kTickMilliseconds));
+		timer_.async_wait(std::bind(&TimingWheel::HandleTick, this, std::placeholders::_1));
+	}
+
+	void HandleTick(const boost::system::error_code& ec)
+	{
+		if (ec)
+		{
+			ticking_ = false;
+			return;
+		}
+
+		//handler执行时间过长时一次补上落下的tick
+		uint64_t now_tick = NowTick();
+		while (current_tick_ < now_tick && armed_count_ != 0)
+		{
+			++current_tick_;
+			Cascade();
+			Expire();
+		}
+
+		if (armed_count_ == 0)
+		{
+			ticking_ = false;
+			return;
+		}
+
+		if (current_tick_ < now_tick)
+			current_tick_ = now_tick;
+		ExpiresTick();
+	}
+
+	//低层转完一圈时,把上一层对应槽里的Entry重新分配到下面的层
+	void Cascade()
+	{
+		for (uint32_t level = 1; level < kLevels; ++level)
+		{
+			if ((current_tick_ & (((uint64_t)1 << (kSlotBits * level)) - 1)) != 0)
+				break;
+
+			uint32_t index = (uint32_t)((current_tick_ >> (kSlotBits * level)) & (kSlots - 1));
+			Entry pending;
+			TakeSlot(slots_[level * kSlots + index], pending);
+			while (pending.next_ != &pending)
+			{
+				Entry& entry = *pending.next_;
+				Unlink(entry);
+				Insert(entry);
+			}
+		}
+	}
+
+	void Expire()
+	{
+		Entry pending;
+		TakeSlot(slots_[current_tick_ & (kSlots - 1)], pending);
+
+		while (pending.next_ != &pending)
+		{
+			Entry& entry = *pending.next_;
+			Unlink(entry);
+
+			//Rearm延后过的
+			if (entry.expire_tick_ > current_tick_)
+			{
+				Insert(entry);
+				continue;
+			}
+
+			--armed_count_;
+			std::shared_ptr<void> owner(std::move(entry.owner_));
+			if (entry.handler_)
+				entry.handler_();
+		}
+	}
+
+	//把槽里的链表整体移到pending,遍历期间handler可以Cancel其中任意Entry
+	static void TakeSlot(Entry& slot, Entry& pending)
+	{
+		InitList(pending);
+		if (slot.next_ == &slot)
+			return;
+
+		pending.next_ = slot.next_;
+		pending.prev_ = slot.prev_;
+		pending.next_->prev_ = &pending;
+		pending.prev_->next_ = &pending;
+		InitList(slot);
+	}
+
+	void ReleaseAll()
+	{
+		std::vector<std::shared_ptr<void>> owners;
+		for (auto& slot : slots_)
+		{
+			while (slot.next_ != nullptr && slot.next_ != &slot)
+			{
+				Entry& entry = *slot.next_;
+				Unlink(entry);
+				owners.push_back(std::move(entry.owner_));
+			}
+		}
+		armed_count_ = 0;
+	}
+
+	boost::asio::steady_timer timer_;
+	std::chrono::steady_clock::time_point epoch_;
+	uint64_t current_tick_;
+	size_t armed_count_;
+	bool ticking_;
+	Entry slots_[kLevels * kSlots];		//每个槽是一个带头结点的环形链表
+};
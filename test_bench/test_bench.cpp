@@ -0,0 +1,1049 @@
+// test_bench.cpp: 收发路径的性能对比
+// 用法: test_bench [gather|queue|frame|scan|affinity|alloc|idle|varint|all]
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "net/tcpserver.hpp"
+#include "buffer/bytescan.hpp"
+#include "buffer/bufferallocator.hpp"
+
+#if defined(__linux__)
+#include <dlfcn.h>
+#include <sys/socket.h>
+
+//Linux上asio用send/sendmsg发送、recv/recvmsg接收(单个buffer时用send/recv),在这里截获以统计系统调用次数
+//只统计服务端的io线程;glibc 2.34之前需要链接-ldl
+static std::atomic<uint64_t> g_send_calls(0);
+static std::atomic<uint64_t> g_recv_calls(0);
+static thread_local bool g_uncounted_thread = false;
+
+template <typename Func>
+static Func NextSymbol(const char* name)
+{
+	return (Func)dlsym(RTLD_NEXT, name);
+}
+
+extern "C" ssize_t send(int fd, const void* data, size_t size, int flags)
+{
+	static auto real = NextSymbol<ssize_t(*)(int, const void*, size_t, int)>("send");
+	if (!g_uncounted_thread)
+		g_send_calls.fetch_add(1, std::memory_order_relaxed);
+	return real(fd, data, size, flags);
+}
+
+extern "C" ssize_t sendmsg(int fd, const struct msghdr* message, int flags)
+{
+	static auto real = NextSymbol<ssize_t(*)(int, const struct msghdr*, int)>("sendmsg");
+	if (!g_uncounted_thread)
+		g_send_calls.fetch_add(1, std::memory_order_relaxed);
+	return real(fd, message, flags);
+}
+
+extern "C" ssize_t recv(int fd, void* data, size_t size, int flags)
+{
+	static auto real = NextSymbol<ssize_t(*)(int, void*, size_t, int)>("recv");
+	if (!g_uncounted_thread)
+		g_recv_calls.fetch_add(1, std::memory_order_relaxed);
+	return real(fd, data, size, flags);
+}
+
+extern "C" ssize_t recvmsg(int fd, struct msghdr* message, int flags)
+{
+	static auto real = NextSymbol<ssize_t(*)(int, struct msghdr*, int)>("recvmsg");
+	if (!g_uncounted_thread)
+		g_recv_calls.fetch_add(1, std::memory_order_relaxed);
+	return real(fd, message, flags);
+}
+
+#define BENCH_COUNT_SYSCALLS
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static double ElapsedSeconds(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//客户端线程的系统调用不计入统计
+static void MarkClientThread()
+{
+#if defined(BENCH_COUNT_SYSCALLS)
+	g_uncounted_thread = true;
+#endif
+}
+
+static void ResetSyscalls()
+{
+#if defined(BENCH_COUNT_SYSCALLS)
+	g_send_calls = 0;
+	g_recv_calls = 0;
+#endif
+}
+
+//返回-1表示当前平台不统计
+static int64_t GetSendCalls()
+{
+#if defined(BENCH_COUNT_SYSCALLS)
+	return (int64_t)g_send_calls.load();
+#else
+	return -1;
+#endif
+}
+
+static int64_t GetRecvCalls()
+{
+#if defined(BENCH_COUNT_SYSCALLS)
+	return (int64_t)g_recv_calls.load();
+#else
+	return -1;
+#endif
+}
+
+static boost::asio::ip::tcp::endpoint LocalEndpoint(uint16_t port)
+{
+	return boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port);
+}
+
+static void WaitFor(const std::atomic<bool>& flag)
+{
+	while (!flag)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//gather: 发送队列里积压的小消息合并成一次gather写
+
+class StreamSession : public TcpSession<StreamSession>
+{
+public:
+	StreamSession(boost::asio::io_service& ios, uint64_t sessionid, uint32_t check_recv_timeout_seconds = 0) :
+		TcpSession(ios, sessionid, check_recv_timeout_seconds)
+	{
+	}
+};
+
+class GatherServer : public TcpServer<StreamSession>
+{
+public:
+	explicit GatherServer(uint16_t port) :TcpServer(port, 1), connected_(false) {}
+
+	virtual void OnConnect(std::shared_ptr<StreamSession> spsession)
+	{
+		session_ = spsession;
+		connected_ = true;
+	}
+
+	virtual void OnClose(std::shared_ptr<StreamSession> spsession, boost::system::error_code const& /*ec*/)
+	{
+		session_mng_.Remove(spsession->GetSessionID());
+	}
+
+	//只发不收,对端发来的数据直接丢弃
+	virtual uint32_t OnRecv(std::shared_ptr<StreamSession> /*spsession*/, DataBuffer& recv_data)
+	{
+		recv_data.Read(nullptr, recv_data.GetDataSize());
+		return 0;
+	}
+
+	std::shared_ptr<StreamSession> session_;
+	std::atomic<bool> connected_;
+};
+
+//原来的发送方式:加锁入队,每条消息单独一次async_write,写完一条再写下一条
+//和原来的TcpSession::Send一样在调用者线程里发起第一次async_write
+class PerMessageWriter
+{
+public:
+	explicit PerMessageWriter(boost::asio::ip::tcp::socket& socket) :socket_(socket) {}
+
+	void Send(std::string data)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		bool write_in_progress = !messages_.empty();
+		messages_.push_back(std::move(data));
+		if (!write_in_progress)
+			DoWrite();
+	}
+
+	bool IsIdle()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		return messages_.empty();
+	}
+
+private:
+	void DoWrite()
+	{
+		boost::asio::async_write(socket_, boost::asio::buffer(messages_.front()),
+			[this](const boost::system::error_code& ec, std::size_t /*bytes_transferred*/) { HandleWrite(ec); });
+	}
+
+	void HandleWrite(const boost::system::error_code& ec)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		messages_.pop_front();
+		if (ec)
+			messages_.clear();
+		else if (!messages_.empty())
+			DoWrite();
+	}
+
+	boost::asio::ip::tcp::socket& socket_;
+	std::mutex mutex_;
+	std::deque<std::string> messages_;
+};
+
+//batched为false时绕过TcpSession::Send,用PerMessageWriter在同一个连接上按原来的方式发送
+static void RunGather(bool batched)
+{
+	const size_t kMessages = 200000;
+	const size_t kMessageSize = 64;
+
+	GatherServer server(18101);
+	server.Start();
+
+	boost::asio::io_service ios;
+	boost::asio::ip::tcp::socket socket(ios);
+	socket.connect(LocalEndpoint(18101));
+	WaitFor(server.connected_);
+
+	//客户端只读,读满kMessages条为止
+	std::thread reader([&socket, kMessages, kMessageSize]() {
+		MarkClientThread();
+		std::vector<char> buffer(256 * 1024);
+		size_t remain = kMessages * kMessageSize;
+		boost::system::error_code ec;
+		while (remain != 0 && !ec)
+			remain -= std::min(remain, socket.read_some(boost::asio::buffer(buffer), ec));
+	});
+
+	PerMessageWriter writer(server.session_->GetSocket());
+
+	MarkClientThread();
+	ResetSyscalls();
+	auto start = Clock::now();
+	for (size_t i = 0; i < kMessages; ++i)
+	{
+		if (batched)
+			server.session_->Send(std::string(kMessageSize, 'g'));
+		else
+			writer.Send(std::string(kMessageSize, 'g'));
+	}
+	reader.join();
+	double seconds = ElapsedSeconds(start);
+	int64_t calls = GetSendCalls();
+
+	printf("gather: %s, %zu x %zu B messages, %.0f msg/s", batched ? "TcpSession::Send (batched)" : "one write per message", kMessages, kMessageSize, kMessages / seconds);
+	if (calls > 0)
+		printf(", %lld send syscalls, %.1f messages per syscall", (long long)calls, (double)kMessages / calls);
+	printf("\n");
+
+	//最后一个HandleWrite可能还没执行完
+	while (!writer.IsIdle())
+		std::this_thread::yield();
+
+	socket.close();
+	server.session_.reset();
+	server.Stop();
+}
+
+static void BenchGather()
+{
+	RunGather(false);
+	RunGather(true);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//queue: 多个生产者入队、io线程批量取出,无锁SendQueue对比原来的std::mutex + std::deque
+
+//原来Send/HandleWrite的做法:生产者加锁push_back,io线程每写完一条加锁pop_front
+class MutexSendQueue
+{
+public:
+	void Push(std::string data)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		messages_.push_back(std::move(data));
+	}
+
+	size_t PopFront()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (messages_.empty())
+			return 0;
+
+		messages_.pop_front();
+		return 1;
+	}
+
+private:
+	std::mutex mutex_;
+	std::deque<std::string> messages_;
+};
+
+template <typename Produce, typename Consume>
+static double RunProducers(size_t producers, size_t messages_per_producer, Produce produce, Consume consume)
+{
+	size_t total = producers * messages_per_producer;
+	auto start = Clock::now();
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < producers; ++i)
+	{
+		threads.emplace_back([&produce, messages_per_producer]() {
+			for (size_t n = 0; n < messages_per_producer; ++n)
+				produce();
+		});
+	}
+
+	size_t consumed = 0;
+	while (consumed < total)
+	{
+		size_t n = consume();
+		if (n == 0)
+			std::this_thread::yield();
+		consumed += n;
+	}
+
+	for (auto& t : threads)
+		t.join();
+
+	return total / ElapsedSeconds(start);
+}
+
+//单线程:每轮入队batch条再全部取出,排除线程调度的影响,只看积压batch条时每条消息的开销
+static void RunQueueBatches(size_t batch, size_t messages, size_t message_size)
+{
+	MutexSendQueue mutex_queue;
+	auto start = Clock::now();
+	for (size_t i = 0; i < messages; i += batch)
+	{
+		for (size_t n = 0; n < batch; ++n)
+			mutex_queue.Push(std::string(message_size, 'q'));
+		while (mutex_queue.PopFront() != 0)
+			;
+	}
+	double mutex_ns = ElapsedSeconds(start) * 1e9 / messages;
+
+	SendQueue send_queue;
+	start = Clock::now();
+	for (size_t i = 0; i < messages; i += batch)
+	{
+		for (size_t n = 0; n < batch; ++n)
+			send_queue.Push(new SendNode(std::string(message_size, 'q')));
+		send_queue.Collect();
+		send_queue.PopFront(batch);
+		send_queue.Release();
+	}
+	double lockfree_ns = ElapsedSeconds(start) * 1e9 / messages;
+
+	printf("queue: single thread, %zu queued per drain, mutex+deque %.1f ns/msg, SendQueue %.1f ns/msg\n", batch, mutex_ns, lockfree_ns);
+}
+
+static void BenchQueue()
+{
+	const size_t kMessages = 2000000;
+	const size_t kMessageSize = 32;
+	const size_t kWriteBatch = 64;		//TcpSession::kMaxWriteBatchBuffers
+
+	for (size_t producers : { 1, 2, 4, 8, 16, 32 })
+	{
+		size_t messages_per_producer = kMessages / producers;
+
+		MutexSendQueue mutex_queue;
+		double mutex_rate = RunProducers(producers, messages_per_producer,
+			[&]() { mutex_queue.Push(std::string(kMessageSize, 'q')); },
+			[&]() { return mutex_queue.PopFront(); });
+
+		SendQueue send_queue;
+		double lockfree_rate = RunProducers(producers, messages_per_producer,
+			[&]() { send_queue.Push(new SendNode(std::string(kMessageSize, 'q'))); },
+			[&]() {
+				//和DoWrite相同:取出新入队的节点,每次最多kWriteBatch个组成一次写,队列空了才回到空闲
+				send_queue.Collect();
+				size_t n = 0;
+				for (SendNode* node = send_queue.Front(); node != nullptr && n < kWriteBatch; node = node->next_)
+					++n;
+				send_queue.PopFront(n);
+				if (send_queue.Empty())
+					send_queue.Release();
+				return n;
+			});
+
+		printf("queue: %zu producer(s), mutex+deque %.2f M msg/s, SendQueue %.2f M msg/s\n", producers, mutex_rate / 1e6, lockfree_rate / 1e6);
+	}
+
+	for (size_t batch : { 64, 1024, 65536 })
+		RunQueueBatches(batch, kMessages, kMessageSize);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//frame: 4字节大端长度包头 + 包体,HeaderBodyFramer在同一个接收缓冲区里解析包头和包体
+
+class FrameSession : public TcpSession<FrameSession, HeaderBodyFramer>
+{
+public:
+	FrameSession(boost::asio::io_service& ios, uint64_t sessionid, uint32_t check_recv_timeout_seconds = 0) :
+		TcpSession(ios, sessionid, check_recv_timeout_seconds)
+	{
+	}
+};
+
+class FrameServer : public TcpServer<FrameSession>
+{
+public:
+	explicit FrameServer(uint16_t port) :TcpServer(port, 1), connected_(false), frames_(0) {}
+
+	virtual uint32_t OnGetHeaderLength()
+	{
+		return 4;
+	}
+
+	virtual int32_t OnGetBodyLength(std::shared_ptr<FrameSession> /*spsession*/, BufferView header)
+	{
+		return (int32_t)(((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) | ((uint32_t)header[2] << 8) | (uint32_t)header[3]);
+	}
+
+	virtual int32_t OnMessage(std::shared_ptr<FrameSession> /*spsession*/, BufferView /*header*/, BufferView /*body*/)
+	{
+		frames_.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	virtual void OnConnect(std::shared_ptr<FrameSession> /*spsession*/)
+	{
+		connected_ = true;
+	}
+
+	virtual void OnClose(std::shared_ptr<FrameSession> spsession, boost::system::error_code const& /*ec*/)
+	{
+		session_mng_.Remove(spsession->GetSessionID());
+	}
+
+	std::atomic<bool> connected_;
+	std::atomic<uint64_t> frames_;
+};
+
+//原来的HeaderBody模式:每个包先async_read包头,再async_read包体,包头包体读到单独的header_/body_里
+//不经过TcpServer,自己accept一个连接,在单独的io线程里读
+class TwoReadFrameServer
+{
+public:
+	explicit TwoReadFrameServer(uint16_t port) :connected_(false), frames_(0), acceptor_(ios_, LocalEndpoint(port)), socket_(ios_) {}
+
+	void Start()
+	{
+		acceptor_.async_accept(socket_, [this](const boost::system::error_code& ec) {
+			if (ec)
+				return;
+			connected_ = true;
+			ReadHeader();
+		});
+		thread_ = std::thread([this]() { ios_.run(); });
+	}
+
+	void Stop()
+	{
+		ios_.stop();
+		thread_.join();
+	}
+
+	std::atomic<bool> connected_;
+	std::atomic<uint64_t> frames_;
+
+private:
+	void ReadHeader()
+	{
+		header_.resize(4);
+		boost::asio::async_read(socket_, boost::asio::buffer(header_),
+			[this](const boost::system::error_code& ec, std::size_t /*bytes_transferred*/) { HandleReadHeader(ec); });
+	}
+
+	void HandleReadHeader(const boost::system::error_code& ec)
+	{
+		if (ec)
+			return;
+
+		body_.resize(((uint32_t)header_[0] << 24) | ((uint32_t)header_[1] << 16) | ((uint32_t)header_[2] << 8) | (uint32_t)header_[3]);
+		boost::asio::async_read(socket_, boost::asio::buffer(body_),
+			[this](const boost::system::error_code& ec, std::size_t /*bytes_transferred*/) { HandleReadBody(ec); });
+	}
+
+	void HandleReadBody(const boost::system::error_code& ec)
+	{
+		if (ec)
+			return;
+
+		frames_.fetch_add(1, std::memory_order_relaxed);
+		ReadHeader();
+	}
+
+	boost::asio::io_service ios_;
+	boost::asio::ip::tcp::acceptor acceptor_;
+	boost::asio::ip::tcp::socket socket_;
+	std::vector<uint8_t> header_;
+	std::vector<uint8_t> body_;
+	std::thread thread_;
+};
+
+//客户端把stream按kChunkSize分块写给server,等server收完frames个包
+template <typename Server>
+static void RunFrame(const char* name, Server& server, uint16_t port, const std::string& stream, size_t frames, size_t body_size)
+{
+	const size_t kChunkSize = 64 * 1024;
+
+	MarkClientThread();
+	boost::asio::io_service ios;
+	boost::asio::ip::tcp::socket socket(ios);
+	socket.connect(LocalEndpoint(port));
+	WaitFor(server.connected_);
+
+	ResetSyscalls();
+	auto start = Clock::now();
+	for (size_t pos = 0; pos < stream.size(); pos += kChunkSize)
+		boost::asio::write(socket, boost::asio::buffer(&stream[pos], std::min(kChunkSize, stream.size() - pos)));
+	while (server.frames_ < frames)
+		std::this_thread::yield();
+	double seconds = ElapsedSeconds(start);
+	int64_t calls = GetRecvCalls();
+
+	printf("frame: %s, %zu x (4 + %zu) B frames, %.0f frames/s", name, frames, body_size, frames / seconds);
+	if (calls > 0)
+		printf(", %lld recv syscalls, %.1f frames per syscall", (long long)calls, (double)frames / calls);
+	printf("\n");
+
+	socket.close();
+}
+
+static void BenchFrame()
+{
+	const size_t kFrames = 500000;
+	const size_t kBodySize = 60;
+
+	//预先编好所有包,客户端分块写,包会跨块
+	std::string stream;
+	stream.reserve(kFrames * (4 + kBodySize));
+	for (size_t i = 0; i < kFrames; ++i)
+	{
+		stream.push_back(0);
+		stream.push_back(0);
+		stream.push_back(0);
+		stream.push_back((char)kBodySize);
+		stream.append(kBodySize, 'f');
+	}
+
+	TwoReadFrameServer two_read_server(18105);
+	two_read_server.Start();
+	RunFrame("header and body read separately", two_read_server, 18105, stream, kFrames, kBodySize);
+	two_read_server.Stop();
+
+	FrameServer server(18102);
+	server.Start();
+	RunFrame("HeaderBodyFramer (single buffer)", server, 18102, stream, kFrames, kBodySize);
+	server.Stop();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//scan: DelimiterFramer查找分隔符,bytescan的SSE2/AVX2对比逐字节比较
+
+static const uint8_t* ScalarFindByte(const uint8_t* begin, const uint8_t* end, uint8_t value)
+{
+	for (; begin != end; ++begin)
+	{
+		if (*begin == value)
+			return begin;
+	}
+	return nullptr;
+}
+
+static const uint8_t* ScalarFindBytes(const uint8_t* begin, const uint8_t* end, const uint8_t* pattern, size_t pattern_size)
+{
+	for (; (size_t)(end - begin) >= pattern_size; ++begin)
+	{
+		if (*begin == pattern[0] && memcmp(begin, pattern, pattern_size) == 0)
+			return begin;
+	}
+	return nullptr;
+}
+
+//反复从上一个分隔符之后查找,返回找到的个数和GB/s
+template <typename Find>
+static size_t ScanAll(const std::vector<uint8_t>& data, size_t passes, size_t delimiter_size, Find find, double& gbps)
+{
+	size_t found = 0;
+	auto start = Clock::now();
+	for (size_t i = 0; i < passes; ++i)
+	{
+		const uint8_t* begin = data.data();
+		const uint8_t* end = begin + data.size();
+		while (const uint8_t* pos = find(begin, end))
+		{
+			++found;
+			begin = pos + delimiter_size;
+		}
+	}
+	gbps = (double)data.size() * passes / ElapsedSeconds(start) / 1e9;
+	return found;
+}
+
+static void BenchScan()
+{
+	const size_t kDataSize = 64 * 1024 * 1024;
+	const size_t kRecordSize = 1024;
+	const size_t kPasses = 8;
+
+#if defined(BYTESCAN_AVX2)
+	const char* path = "AVX2";
+#elif defined(BYTESCAN_SSE2)
+	const char* path = "SSE2";
+#else
+	const char* path = "scalar";
+#endif
+
+	//每kRecordSize字节一条记录,以"\r\n"结尾
+	std::vector<uint8_t> data(kDataSize, 'a');
+	for (size_t pos = kRecordSize; pos <= kDataSize; pos += kRecordSize)
+	{
+		data[pos - 2] = '\r';
+		data[pos - 1] = '\n';
+	}
+
+	const uint8_t crlf[] = { '\r', '\n' };
+	double scalar_gbps = 0, memchr_gbps = 0, simd_gbps = 0;
+
+	size_t a = ScanAll(data, kPasses, 1, [](const uint8_t* begin, const uint8_t* end) { return ScalarFindByte(begin, end, '\n'); }, scalar_gbps);
+	size_t b = ScanAll(data, kPasses, 1, [](const uint8_t* begin, const uint8_t* end) { return (const uint8_t*)memchr(begin, '\n', end - begin); }, memchr_gbps);
+	size_t c = ScanAll(data, kPasses, 1, [](const uint8_t* begin, const uint8_t* end) { return bytescan::FindByte(begin, end, '\n'); }, simd_gbps);
+	printf("scan: '\\n' every %zu B in %zu MB, scalar %.2f GB/s, memchr %.2f GB/s, FindByte(%s) %.2f GB/s%s\n",
+		kRecordSize, kDataSize >> 20, scalar_gbps, memchr_gbps, path, simd_gbps, (a == b && b == c) ? "" : ", MISMATCH");
+
+	a = ScanAll(data, kPasses, sizeof(crlf), [&crlf](const uint8_t* begin, const uint8_t* end) { return ScalarFindBytes(begin, end, crlf, sizeof(crlf)); }, scalar_gbps);
+	b = ScanAll(data, kPasses, sizeof(crlf), [&crlf](const uint8_t* begin, const uint8_t* end) { return bytescan::FindBytes(begin, end, crlf, sizeof(crlf)); }, simd_gbps);
+	printf("scan: \"\\r\\n\" every %zu B in %zu MB, scalar %.2f GB/s, FindBytes(%s) %.2f GB/s%s\n",
+		kRecordSize, kDataSize >> 20, scalar_gbps, path, simd_gbps, a == b ? "" : ", MISMATCH");
+}
+
+//////////////////////////////////////////////////////////////////////////
+//affinity: 每个io线程一个ping-pong客户端,对比io线程不绑定CPU和SetAutoCpuAffinity
+
+class EchoServer : public TcpServer<StreamSession>
+{
+public:
+	EchoServer(uint16_t port, size_t pool_size) :TcpServer(port, pool_size) {}
+
+	virtual uint32_t OnRecv(std::shared_ptr<StreamSession> spsession, DataBuffer& recv_data)
+	{
+		uint32_t size = recv_data.GetDataSize();
+		spsession->Send(std::string((const char*)recv_data.GetReadPtr(), size));
+		recv_data.Read(nullptr, size);
+		return 0;
+	}
+
+	virtual void OnConnect(std::shared_ptr<StreamSession> /*spsession*/)
+	{
+	}
+
+	virtual void OnClose(std::shared_ptr<StreamSession> spsession, boost::system::error_code const& /*ec*/)
+	{
+		session_mng_.Remove(spsession->GetSessionID());
+	}
+};
+
+//返回所有客户端的平均往返时间(微秒),total_rate为每秒完成的往返次数
+static double RunPingPong(uint16_t port, size_t workers, bool pinned, double& total_rate)
+{
+	const size_t kRoundTrips = 20000;
+	const size_t kMessageSize = 64;
+
+	EchoServer server(port, workers);
+	if (pinned)
+		server.SetAutoCpuAffinity();
+	server.Start();
+
+	//新连接按轮转分配到io线程,workers个连接每个io线程一个
+	std::vector<double> seconds(workers, 0);
+	std::vector<std::thread> clients;
+	auto start = Clock::now();
+	for (size_t i = 0; i < workers; ++i)
+	{
+		clients.emplace_back([&seconds, i, port, kRoundTrips, kMessageSize]() {
+			MarkClientThread();
+			boost::asio::io_service ios;
+			boost::asio::ip::tcp::socket socket(ios);
+			socket.connect(LocalEndpoint(port));
+			socket.set_option(boost::asio::ip::tcp::no_delay(true));
+
+			std::string ping(kMessageSize, 'p');
+			std::string pong(kMessageSize, 0);
+			auto client_start = Clock::now();
+			for (size_t n = 0; n < kRoundTrips; ++n)
+			{
+				boost::asio::write(socket, boost::asio::buffer(ping));
+				boost::asio::read(socket, boost::asio::buffer(&pong[0], pong.size()));
+			}
+			seconds[i] = ElapsedSeconds(client_start);
+		});
+	}
+	for (auto& t : clients)
+		t.join();
+	total_rate = workers * kRoundTrips / ElapsedSeconds(start);
+
+	server.Stop();
+
+	double total_seconds = 0;
+	for (auto s : seconds)
+		total_seconds += s;
+	return total_seconds / (workers * kRoundTrips) * 1e6;
+}
+
+static void BenchAffinity()
+{
+	size_t workers = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+	double unpinned_rate = 0, pinned_rate = 0;
+	double unpinned_rtt = RunPingPong(18103, workers, false, unpinned_rate);
+	double pinned_rtt = RunPingPong(18104, workers, true, pinned_rate);
+
+	printf("affinity: %zu io thread(s), %zu cpu(s) in topology, unpinned %.1f us rtt %.0f msg/s, pinned %.1f us rtt %.0f msg/s\n",
+		workers, cpuaffinity::GetTopology().size(), unpinned_rtt, unpinned_rate, pinned_rtt, pinned_rate);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//alloc: DataBuffer的分配器,PoolAllocator对比直接malloc,包括在其它线程释放
+
+//混合的块大小,和收发缓冲区常见的大小相近
+static std::vector<size_t> MixedSizes(size_t count)
+{
+	const size_t kSizes[] = { 64, 200, 1024, 4096, 16 * 1024, 64 * 1024 };
+	std::vector<size_t> sizes(count);
+	uint32_t seed = 12345;
+	for (auto& size : sizes)
+	{
+		seed = seed * 1103515245 + 12345;
+		size = kSizes[(seed >> 16) % (sizeof(kSizes) / sizeof(kSizes[0]))];
+	}
+	return sizes;
+}
+
+//同一个线程分配、释放,每轮分配一批再全部释放,返回每次分配+释放的纳秒数
+static double AllocLocal(BufferAllocator& allocator, const std::vector<size_t>& sizes, size_t rounds)
+{
+	std::vector<void*> blocks(sizes.size());
+	auto start = Clock::now();
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		for (size_t i = 0; i < sizes.size(); ++i)
+		{
+			blocks[i] = allocator.Allocate(sizes[i]);
+			*(volatile char*)blocks[i] = 1;
+		}
+		for (auto block : blocks)
+			allocator.Deallocate(block);
+	}
+	return ElapsedSeconds(start) * 1e9 / (rounds * sizes.size());
+}
+
+//一个线程分配,另一个线程释放(接收线程分配、业务线程处理完释放的情形),返回每次分配+释放的纳秒数
+static double AllocRemote(BufferAllocator& allocator, const std::vector<size_t>& sizes, size_t rounds)
+{
+	const size_t kMaxPendingBatches = 64;
+
+	std::mutex mutex;
+	std::deque<std::vector<void*>> batches;
+	std::atomic<bool> done(false);
+
+	auto start = Clock::now();
+	std::thread consumer([&]() {
+		for (;;)
+		{
+			std::vector<void*> batch;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (!batches.empty())
+				{
+					batch = std::move(batches.front());
+					batches.pop_front();
+				}
+			}
+
+			if (batch.empty())
+			{
+				if (done)
+					break;
+				std::this_thread::yield();
+				continue;
+			}
+
+			for (auto block : batch)
+				allocator.Deallocate(block);
+		}
+	});
+
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		std::vector<void*> batch(sizes.size());
+		for (size_t i = 0; i < sizes.size(); ++i)
+		{
+			batch[i] = allocator.Allocate(sizes[i]);
+			*(volatile char*)batch[i] = 1;
+		}
+
+		for (;;)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (batches.size() < kMaxPendingBatches)
+			{
+				batches.push_back(std::move(batch));
+				break;
+			}
+			lock.unlock();
+			std::this_thread::yield();
+		}
+	}
+	done = true;
+	consumer.join();
+
+	return ElapsedSeconds(start) * 1e9 / (rounds * sizes.size());
+}
+
+static void BenchAlloc()
+{
+	const size_t kBatch = 256;
+	const size_t kRounds = 4000;
+
+	std::vector<size_t> sizes = MixedSizes(kBatch);
+	BufferAllocator& pool = PoolAllocator::Instance();
+	BufferAllocator& heap = MallocAllocator::Instance();
+
+	//先各跑一轮预热,线程缓存和malloc的arena都建好
+	AllocLocal(pool, sizes, 1);
+	AllocLocal(heap, sizes, 1);
+
+	double heap_local = AllocLocal(heap, sizes, kRounds);
+	double pool_local = AllocLocal(pool, sizes, kRounds);
+	printf("alloc: same thread, 64 B - 64 KB mixed, malloc %.1f ns, PoolAllocator %.1f ns per allocate+free\n", heap_local, pool_local);
+
+	double heap_remote = AllocRemote(heap, sizes, kRounds);
+	double pool_remote = AllocRemote(pool, sizes, kRounds);
+	printf("alloc: freed on another thread, 64 B - 64 KB mixed, malloc %.1f ns, PoolAllocator %.1f ns per allocate+free\n", heap_remote, pool_remote);
+
+	//最后几批是在分配线程停止分配之后才释放的,挂在remote_上;所属线程下一次分配时取回
+	PoolAllocator::Stats stats = PoolAllocator::Instance().GetStats();
+	printf("alloc: remote pending after the run %llu B", (unsigned long long)stats.remote_pending_bytes_);
+	pool.Deallocate(pool.Allocate(64));
+	stats = PoolAllocator::Instance().GetStats();
+	printf(", after one more allocation %llu B\n", (unsigned long long)stats.remote_pending_bytes_);
+
+	printf("alloc: PoolAllocator stats: allocations %llu, cache hits %llu (%.1f%%), remote frees %llu, remote pending %llu B, large %llu, cached %llu B, thread caches %llu\n",
+		(unsigned long long)stats.allocations_, (unsigned long long)stats.cache_hits_,
+		stats.allocations_ == 0 ? 0.0 : 100.0 * stats.cache_hits_ / stats.allocations_,
+		(unsigned long long)stats.remote_frees_, (unsigned long long)stats.remote_pending_bytes_,
+		(unsigned long long)stats.large_allocations_, (unsigned long long)stats.cached_bytes_, (unsigned long long)stats.thread_caches_);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//idle: 接收超时检测在读路径上的开销,IdlePolicy::kTimer(每次读Rearm)对比kSweep(每次读只记时间戳)
+//不经过socket,按TcpSession::HandleReadSome/ExpiresRecvTimer的调用方式直接驱动时间轮和空闲扫描,
+//时间轮和扫描的handler在同一个线程里用poll执行,耗时计入每条消息
+
+struct IdleSlot
+{
+	TimingWheel::Entry timer_entry_;
+	IdleSweeper::Entry sweep_entry_;
+	uint64_t last_read_milliseconds_ = 0;
+};
+
+//返回每条消息的纳秒数,dispatches为期间执行的时间轮handler数,armed为结束时挂在时间轮上的Entry数
+static double RunIdlePolicy(IdlePolicy policy, size_t sessions, double run_seconds, uint64_t& messages, uint64_t& dispatches, size_t& armed)
+{
+	const size_t kChunk = 1024;
+	const std::chrono::seconds kTimeout(30);
+
+	boost::asio::io_service ios;
+	boost::asio::io_service::work work(ios);
+	TimingWheel& timing_wheel = boost::asio::use_service<TimingWheel>(ios);
+	IdleSweeper& idle_sweeper = boost::asio::use_service<IdleSweeper>(ios);
+
+	//第一次读时登记,和ExpiresRecvTimer相同
+	std::vector<IdleSlot> slots(sessions);
+	for (auto& slot : slots)
+	{
+		if (policy == IdlePolicy::kSweep)
+			idle_sweeper.Add(slot.sweep_entry_, &slot.last_read_milliseconds_, kTimeout, nullptr);
+		else
+			timing_wheel.Arm(slot.timer_entry_, kTimeout, nullptr);
+	}
+
+	messages = 0;
+	dispatches = 0;
+	size_t next = 0;
+	auto start = Clock::now();
+	while (ElapsedSeconds(start) < run_seconds)
+	{
+		//消息轮流落到各个session上
+		for (size_t i = 0; i < kChunk; ++i)
+		{
+			IdleSlot& slot = slots[next];
+			if (++next == sessions)
+				next = 0;
+
+			slot.last_read_milliseconds_ = timing_wheel.GetCoarseMilliseconds();
+			if (policy == IdlePolicy::kSweep)
+			{
+				if (!slot.sweep_entry_.IsLinked())
+					idle_sweeper.Add(slot.sweep_entry_, &slot.last_read_milliseconds_, kTimeout, nullptr);
+			}
+			else if (!timing_wheel.Rearm(slot.timer_entry_, kTimeout))
+			{
+				timing_wheel.Arm(slot.timer_entry_, kTimeout, nullptr);
+			}
+		}
+		messages += kChunk;
+		dispatches += ios.poll();
+	}
+	double seconds = ElapsedSeconds(start);
+	armed = timing_wheel.GetArmedCount();
+
+	for (auto& slot : slots)
+	{
+		timing_wheel.Cancel(slot.timer_entry_);
+		idle_sweeper.Remove(slot.sweep_entry_);
+	}
+
+	return seconds * 1e9 / messages;
+}
+
+static void BenchIdle()
+{
+	const double kRunSeconds = 3.0;
+
+	for (size_t sessions : { 1000, 10000, 100000 })
+	{
+		uint64_t timer_messages = 0, timer_dispatches = 0, sweep_messages = 0, sweep_dispatches = 0;
+		size_t timer_armed = 0, sweep_armed = 0;
+		double timer_ns = RunIdlePolicy(IdlePolicy::kTimer, sessions, kRunSeconds, timer_messages, timer_dispatches, timer_armed);
+		double sweep_ns = RunIdlePolicy(IdlePolicy::kSweep, sessions, kRunSeconds, sweep_messages, sweep_dispatches, sweep_armed);
+
+		printf("idle: %zu sessions, kTimer %.2f ns/msg (%llu msgs, %llu timer handlers, %zu wheel entries), kSweep %.2f ns/msg (%llu msgs, %llu timer handlers, %zu wheel entries)\n",
+			sessions, timer_ns, (unsigned long long)timer_messages, (unsigned long long)timer_dispatches, timer_armed,
+			sweep_ns, (unsigned long long)sweep_messages, (unsigned long long)sweep_dispatches, sweep_armed);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+//varint: varint::EncodeArray/DecodeArray对比DataBuffer::WriteIntegerLE/ReadIntegerLE,比较编码后的字节数和每个字段的耗时
+
+static void RunVarint(const char* name, const std::vector<uint64_t>& values, size_t passes)
+{
+	size_t count = values.size();
+
+	//定长:每个字段8字节,逐个WriteIntegerLE/ReadIntegerLE
+	DataBuffer fixed((uint32_t)(count * sizeof(uint64_t)));
+	std::vector<uint64_t> fixed_decoded(count);
+	auto start = Clock::now();
+	for (size_t pass = 0; pass < passes; ++pass)
+	{
+		fixed.SetWritePos(0);
+		fixed.SetReadPos(0);
+		for (auto value : values)
+			fixed.WriteIntegerLE(value);
+	}
+	double fixed_encode_ns = ElapsedSeconds(start) * 1e9 / (passes * count);
+	size_t fixed_bytes = fixed.GetDataSize();
+
+	start = Clock::now();
+	for (size_t pass = 0; pass < passes; ++pass)
+	{
+		fixed.SetReadPos(0);
+		for (auto& value : fixed_decoded)
+			fixed.ReadIntegerLE(value);
+	}
+	double fixed_decode_ns = ElapsedSeconds(start) * 1e9 / (passes * count);
+
+	//varint:按EncodeArray的要求留出MaxSize*count+kMaxVarintSize
+	std::vector<uint8_t> encoded(count * varint::MaxSize<uint64_t>::value + varint::kMaxVarintSize);
+	std::vector<uint64_t> varint_decoded(count);
+	uint8_t* encoded_end = nullptr;
+	start = Clock::now();
+	for (size_t pass = 0; pass < passes; ++pass)
+		encoded_end = varint::EncodeArray(encoded.data(), values.data(), count);
+	double varint_encode_ns = ElapsedSeconds(start) * 1e9 / (passes * count);
+	size_t varint_bytes = encoded_end - encoded.data();
+
+	const uint8_t* decoded_end = nullptr;
+	start = Clock::now();
+	for (size_t pass = 0; pass < passes; ++pass)
+		decoded_end = varint::DecodeArray(encoded.data(), (const uint8_t*)encoded_end, varint_decoded.data(), count);
+	double varint_decode_ns = ElapsedSeconds(start) * 1e9 / (passes * count);
+
+	bool ok = fixed_decoded == values && decoded_end == encoded_end && varint_decoded == values;
+
+	printf("varint: %s, %zu fields, fixed %zu B encode %.2f ns decode %.2f ns, varint %zu B (%.2f B/field) encode %.2f ns decode %.2f ns, round trip %s\n",
+		name, count, fixed_bytes, fixed_encode_ns, fixed_decode_ns,
+		varint_bytes, (double)varint_bytes / count, varint_encode_ns, varint_decode_ns, ok ? "ok" : "MISMATCH");
+}
+
+static void BenchVarint()
+{
+	const size_t kFields = 1000000;
+	const size_t kPasses = 20;
+
+	std::vector<uint64_t> small(kFields);
+	std::vector<uint64_t> full(kFields);
+	uint64_t seed = 88172645463325252ull;
+	for (size_t i = 0; i < kFields; ++i)
+	{
+		//xorshift64
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		small[i] = seed % 1000;		//长度、计数、小枚举等,1~2字节
+		full[i] = seed;				//哈希、随机id,大多9~10字节
+	}
+
+	RunVarint("small values [0, 1000)", small, kPasses);
+	RunVarint("full 64-bit range", full, kPasses);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+	std::string which = argc > 1 ? argv[1] : "all";
+
+	if (which == "gather" || which == "all")
+		BenchGather();
+
+	if (which == "queue" || which == "all")
+		BenchQueue();
+
+	if (which == "frame" || which == "all")
+		BenchFrame();
+
+	if (which == "scan" || which == "all")
+		BenchScan();
+
+	if (which == "affinity" || which == "all")
+		BenchAffinity();
+
+	if (which == "alloc" || which == "all")
+		BenchAlloc();
+
+	if (which == "idle" || which == "all")
+		BenchIdle();
+
+	if (which == "varint" || which == "all")
+		BenchVarint();
+
+	return 0;
+}
@@ -1,7 +1,11 @@
 
 #include "net/tcpclient.hpp"
 
+#ifdef SOCKET_HEADER_BODY_MODE
+class EchoSession : public TcpSession<EchoSession, HeaderBodyFramer>
+#else
 class EchoSession : public TcpSession<EchoSession>
+#endif
 {
 public:
 	EchoSession(boost::asio::io_service& ios, uint64_t sessionid, uint32_t check_recv_timeout_seconds = 0) :
@@ -65,17 +69,17 @@ public:
 	{
 		return 10;
 	};
-	virtual int32_t OnGetBodyLength(std::shared_ptr<EchoSession> spsession, std::vector<uint8_t>& header)
+	virtual int32_t OnGetBodyLength(std::shared_ptr<EchoSession> spsession, BufferView header)
 	{
 		return 10;
 	}
 
-	virtual int32_t OnMessage(std::shared_ptr<EchoSession> spsession, std::vector<uint8_t>& header, std::vector<uint8_t>& body)
+	virtual int32_t OnMessage(std::shared_ptr<EchoSession> spsession, BufferView header, BufferView body)
 	{
-		printf("FILE:%s,FUNCTION:%s,LINE:%d,SessionID:%lld,Local:%s:%d,Remote:%s:%d,%s%s\n", __FILE__, __FUNCTION__, __LINE__, spsession->GetSessionID(), \
+		printf("FILE:%s,FUNCTION:%s,LINE:%d,SessionID:%lld,Local:%s:%d,Remote:%s:%d,%.*s%.*s\n", __FILE__, __FUNCTION__, __LINE__, spsession->GetSessionID(), \
 			spsession->GetLocalEndpoint().address().to_string().c_str(), spsession->GetLocalEndpoint().port(),
 			spsession->GetRemoteEndpoint().address().to_string().c_str(), spsession->GetRemoteEndpoint().port(),
-			header.data(), body.data()
+			(int)header.GetSize(), (const char*)header.GetData(), (int)body.GetSize(), (const char*)body.GetData()
 		);
 
 		return 0;
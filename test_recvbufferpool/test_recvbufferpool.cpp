@@ -0,0 +1,100 @@
+// test_recvbufferpool.cpp: session关闭后RecvBufferPool和RecvBufferBudget的计数检查
+//
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include "net/tcpserver.hpp"
+
+static int failures = 0;
+static std::atomic<int> destroyed(0);
+
+static void Check(bool ok, const char* name, unsigned long long value, unsigned long long expected)
+{
+	printf("%s %s: %llu, expected %llu\n", ok ? "[ OK ]" : "[FAIL]", name, value, expected);
+	if (!ok)
+		++failures;
+}
+
+class CountedSession : public TcpSession<CountedSession>
+{
+public:
+	CountedSession(boost::asio::io_service& ios, uint64_t sessionid, uint32_t check_recv_timeout_seconds = 0) :
+		TcpSession(ios, sessionid, check_recv_timeout_seconds)
+	{
+	}
+	~CountedSession()
+	{
+		++destroyed;
+	}
+};
+
+class EchoServer : public TcpServer<CountedSession>
+{
+public:
+	EchoServer(uint16_t port) :TcpServer(port, 2) {}
+
+	virtual uint32_t OnRecv(std::shared_ptr<CountedSession> spsession, DataBuffer& recv_data)
+	{
+		uint32_t size = recv_data.GetDataSize();
+		spsession->Send(recv_data.GetReadPtr(), size);
+		recv_data.Read(nullptr, size);
+		return 0;
+	}
+
+	virtual void OnConnect(std::shared_ptr<CountedSession> /*spsession*/)
+	{
+	}
+
+	virtual void OnClose(std::shared_ptr<CountedSession> spsession, boost::system::error_code const& /*ec*/)
+	{
+		session_mng_.Remove(spsession->GetSessionID());
+	}
+};
+
+//连接count次,每次收发一条消息后关闭,等所有session析构后检查计数
+static void OpenAndClose(uint16_t port, bool pooled, int count)
+{
+	EchoServer server(port);
+	RecvBufferPolicy policy;
+	policy.pooled_ = pooled;
+	server.SetRecvBufferPolicy(policy);
+	server.Start();
+
+	destroyed = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		boost::asio::io_service ios;
+		boost::asio::ip::tcp::socket socket(ios);
+		socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port));
+
+		char data[16] = "recvbufferpool";
+		boost::asio::write(socket, boost::asio::buffer(data));
+		boost::asio::read(socket, boost::asio::buffer(data));
+		socket.close();
+	}
+
+	for (int i = 0; i < 500 && destroyed < count; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	const char* mode = pooled ? "pooled" : "not pooled";
+	printf("%s: %d sessions destroyed\n", mode, destroyed.load());
+	Check(destroyed == count, "sessions destroyed", destroyed, count);
+
+	RecvBufferPool::Stats stats = RecvBufferPool::GetStats();
+	Check(stats.lent_ == 0, "lent", stats.lent_, 0);
+	Check(stats.waiting_ == 0, "waiting", stats.waiting_, 0);
+	Check(RecvBufferBudget::GetTotal() == 0, "budget total", RecvBufferBudget::GetTotal(), 0);
+
+	server.Stop();
+}
+
+int main()
+{
+	OpenAndClose(18111, false, 20);
+	OpenAndClose(18112, true, 20);
+	OpenAndClose(18113, false, 20);
+
+	printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
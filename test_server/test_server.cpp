@@ -27,7 +27,7 @@ public:
 	{
 		return 10;
 	};
-	virtual int32_t OnGetBodyLength(std::shared_ptr<EchoSession> spsession, std::vector<uint8_t>& header)
+	virtual int32_t OnGetBodyLength(std::shared_ptr<EchoSession> spsession, BufferView header)
 	{
 		return 100;
 	}
@@ -36,7 +36,7 @@ public:
 		TcpServer::OnConnect(spsession);
 		spsession->SetRecvTimeOut(10);
 	};
-	virtual int32_t OnMessage(std::shared_ptr<EchoSession> spsession, std::vector<uint8_t>& header, std::vector<uint8_t>& body)
+	virtual int32_t OnMessage(std::shared_ptr<EchoSession> spsession, BufferView header, BufferView body)
 	{
 		//printf("header:%s\n", std::string(header.begin(), header.end()).c_str());
 		//printf("body:%s\n", std::string(body.begin(), body.end()).c_str());
@@ -0,0 +1,65 @@
+// test_timingwheel.cpp: TimingWheel的到期时间检查
+//
+
+#include <stdio.h>
+#include <thread>
+#include <future>
+#include "net/timingwheel.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void Check(bool ok, const char* name, long long elapsed_ms, long long min_ms, long long max_ms)
+{
+	printf("%s %s: elapsed %lld ms, expected [%lld, %lld]\n", ok ? "[ OK ]" : "[FAIL]", name, elapsed_ms, min_ms, max_ms);
+	if (!ok)
+		++failures;
+}
+
+//在io线程里Arm一个delay的Entry,返回从Arm到handler执行的毫秒数
+static long long ArmAndWait(boost::asio::io_service& ios, TimingWheel::Entry& entry, std::chrono::milliseconds delay)
+{
+	std::promise<long long> fired;
+	Clock::time_point start;
+
+	ios.post([&]() {
+		entry.SetHandler([&]() {
+			fired.set_value(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+		});
+		start = Clock::now();
+		boost::asio::use_service<TimingWheel>(ios).Arm(entry, delay, nullptr);
+	});
+
+	return fired.get_future().get();
+}
+
+int main()
+{
+	boost::asio::io_service ios;
+	boost::asio::io_service::work work(ios);
+	std::thread runner([&ios]() { ios.run(); });
+
+	const long long tick = TimingWheel::kTickMilliseconds;
+	TimingWheel::Entry entry;
+
+	//第一次Arm,时间轮从未推进
+	long long elapsed = ArmAndWait(ios, entry, std::chrono::milliseconds(500));
+	Check(elapsed >= 500 - tick && elapsed <= 500 + 2 * tick, "first arm", elapsed, 500 - tick, 500 + 2 * tick);
+
+	//时间轮停止一段时间后再Arm,到期时间要从Arm的时刻算起
+	std::this_thread::sleep_for(std::chrono::milliseconds(3000));
+	elapsed = ArmAndWait(ios, entry, std::chrono::milliseconds(5000));
+	Check(elapsed >= 5000 - tick && elapsed <= 5000 + 2 * tick, "arm after idle", elapsed, 5000 - tick, 5000 + 2 * tick);
+
+	//停止时间超过第0层一圈(64个tick)
+	std::this_thread::sleep_for(std::chrono::milliseconds(7000));
+	elapsed = ArmAndWait(ios, entry, std::chrono::milliseconds(1000));
+	Check(elapsed >= 1000 - tick && elapsed <= 1000 + 2 * tick, "arm after long idle", elapsed, 1000 - tick, 1000 + 2 * tick);
+
+	ios.stop();
+	runner.join();
+
+	printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}